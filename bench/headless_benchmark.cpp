@@ -0,0 +1,519 @@
+// Steps the simulation without a window and reports physics throughput.
+// scripts/benchmark.sh --headless calls it as `binary bodies duration`, once
+// per backend through the headless_benchmark_serial, _omp and _pool links.
+// Several backends given to --backend run one after the other on the same
+// bodies. The parallel backends also run strong and weak scaling studies
+// over thread counts. Runs can start from a checkpoint and end in one, and
+// can stream a trajectory to measure what recording costs.
+#include "Simulation.h"
+#include "Checkpoint.h"
+#include "Benchmark.hpp"
+#include "ForceKernel.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Same world as the windowed binaries
+const float G = 1.0f;
+const float WIDTH = 1920.0f;
+const float HEIGHT = 1080.0f;
+
+struct Settings {
+    std::vector<std::string> backends;  // Empty for the one the program name implies
+    int numBodies = 1000;
+    double duration = 10.0;
+    long fixedSteps = 0;
+    float dt = 0.001f;
+    float softening = 2.0f;
+    ForceMethod forceMethod = ForceMethod::Direct;
+    Integrator integrator = Integrator::Euler;
+    ReorderSettings reorder;
+    AffinityMode affinity = AffinityMode::None;
+    InitialConditions initialConditions;  // Fixed seed, so runs start from the same bodies
+    std::string resultsPath = "benchmark_results.csv";
+    std::string profilePath;
+    std::string restorePath;     // Start from this checkpoint instead of random bodies
+    std::string checkpointPath;  // Write a checkpoint when the runs are done
+    std::string trajectoryPath;  // Record frames during all runs, warm-up included
+    TrajectorySettings trajectory;
+
+    // Scaling study
+    std::string scaling;                 // "", "strong" or "weak"
+    std::vector<int> threadCounts;
+    std::vector<int> sizes;
+    std::string scalingPath = "scaling_results.csv";
+};
+
+void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [options] [numBodies] [durationSeconds]\n";
+    std::cout << "  numBodies:       Number of bodies (default: 1000, min: 2)\n";
+    std::cout << "  durationSeconds: Measured run time after warm-up (default: 10)\n";
+    std::cout << "Options:\n";
+    std::cout << "  --backend=NAME[,NAME...]    serial|openmp|pool, in turn on the same bodies (default: openmp)\n";
+    std::cout << "  --ic=disk|plummer|uniform|galaxies  Initial bodies (default: disk)\n";
+    std::cout << "  --seed=N                    Seed of the initial bodies (default: 1)\n";
+    std::cout << "  --steps=N                   Run exactly N measured steps instead of a duration\n";
+    std::cout << "  --dt=VALUE                  Time step (default: 0.001)\n";
+    std::cout << "  --softening=VALUE           Softening (default: 2.0)\n";
+    std::cout << "  --solver=direct|barnes-hut|pm  Force solver (default: direct)\n";
+    std::cout << "  --integrator=NAME           euler|leapfrog|verlet|yoshida4|block (default: euler)\n";
+    std::cout << "  --reorder=none|morton|hilbert  Space-filling curve to sort bodies along (default: hilbert)\n";
+    std::cout << "  --reorder-interval=N        Steps between sorts, 0 to disable (default: 32)\n";
+    std::cout << "  --affinity=none|compact|spread  Pin threads to cores, spread over NUMA nodes (default: none)\n";
+    std::cout << "  --results=FILE              Results file, .json for JSON lines (default: benchmark_results.csv)\n";
+    std::cout << "  --profile=FILE              Record phase timings of the measured steps as a Chrome trace\n";
+    std::cout << "  --restore=FILE              Start from a checkpoint; its bodies and settings replace the above\n";
+    std::cout << "  --checkpoint=FILE           Write a checkpoint after the last run\n";
+    std::cout << "  --trajectory=FILE           Stream positions and velocities to FILE\n";
+    std::cout << "  --trajectory-interval=K     Steps between trajectory frames (default: 10)\n";
+    std::cout << "  --trajectory-encoding=raw|quantized|delta  Frame encoding (default: delta)\n";
+    std::cout << "  --trajectory-precision=Q    Delta encoding: fixed-point step (default: 0.001)\n";
+    std::cout << "Scaling study (openmp and pool backends):\n";
+    std::cout << "  --scaling=strong|weak       Sweep thread counts at fixed size, or with work per thread fixed\n";
+    std::cout << "  --threads=N1,N2,...         Thread counts (default: powers of two up to the core count)\n";
+    std::cout << "  --sizes=N1,N2,...           Body counts, per study at one thread for weak scaling\n";
+    std::cout << "  --scaling-results=FILE      Scaling results (default: scaling_results.csv)\n";
+}
+
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+std::vector<int> parseList(const std::string& list) {
+    std::vector<int> values;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) values.push_back(std::stoi(item));
+    }
+    return values;
+}
+
+// Timings of one measured run
+struct Run {
+    double elapsed = 0.0;
+    uint64_t evaluations = 0;
+    uint64_t reorders = 0;
+    double reorderSeconds = 0.0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Steps until the step times settle, then for the duration or the fixed
+// number of steps with the profiler recording if `profile` is set
+Run runMeasured(Simulation& simulation, Benchmark& benchmark, const Settings& settings, bool profile) {
+    auto timedStep = [&]() {
+        Clock::time_point stepStart = Clock::now();
+        simulation.update();
+        Clock::time_point stepEnd = Clock::now();
+        benchmark.addFrameTime(std::chrono::duration<double>(stepEnd - stepStart).count());
+        return stepEnd;
+    };
+
+    // Warm-up: fill caches and grow scratch buffers until step times settle
+    while (!benchmark.isWarmedUp()) {
+        timedStep();
+    }
+
+    if (profile) {
+        Profiler::clear();
+        Profiler::enable(true);
+    }
+    Run run;
+    const uint64_t evaluationsBefore = simulation.getForceEvaluations();
+    const uint64_t reordersBefore = simulation.getReorderCount();
+    const double reorderSecondsBefore = simulation.getReorderSeconds();
+    Clock::time_point start = Clock::now();
+    while (settings.fixedSteps > 0 ? static_cast<long>(benchmark.getMeasuredFrames()) < settings.fixedSteps
+                                   : run.elapsed < settings.duration) {
+        run.elapsed = std::chrono::duration<double>(timedStep() - start).count();
+    }
+    if (profile) Profiler::enable(false);
+
+    run.evaluations = simulation.getForceEvaluations() - evaluationsBefore;
+    run.reorders = simulation.getReorderCount() - reordersBefore;
+    run.reorderSeconds = simulation.getReorderSeconds() - reorderSecondsBefore;
+    return run;
+}
+
+Benchmark::Metadata metadataOf(const Simulation& simulation) {
+    Benchmark::Metadata metadata;
+    metadata.threads = simulation.getThreadCount();
+    metadata.dt = simulation.getTimeStep();
+    metadata.softening = simulation.getSoftening();
+    metadata.solver = forceMethodName(simulation.getForceMethod());
+    metadata.integrator = integratorName(simulation.getIntegrator());
+    return metadata;
+}
+
+// One measured run on the simulation's current backend
+void benchmarkBackend(Simulation& simulation, const Settings& settings) {
+    const size_t n = simulation.getStore().size();
+    const char* implementation = simulation.getBackend().label();
+
+    std::cout << implementation << " headless benchmark: " << n << " bodies, "
+              << simulation.getThreadCount() << " thread(s), " << integratorName(simulation.getIntegrator())
+              << ", kernel " << forceKernelName() << std::endl;
+    // Pinned runs report their mapping on the first step
+    if (settings.affinity == AffinityMode::None) {
+        printPlacement(std::cout, settings.affinity, simulation.measureThreadPlacement());
+    }
+
+    Benchmark benchmark(implementation, static_cast<int>(n));
+    benchmark.setMetadata(metadataOf(simulation));
+
+    // Measured run, profiled if asked for
+    const bool profile = !settings.profilePath.empty();
+    if (profile) Profiler::setThreadName("main");
+    Run run = runMeasured(simulation, benchmark, settings, profile);
+    std::cout << "Warm-up:        " << benchmark.getWarmupFrames() << " steps" << std::endl;
+
+    const double steps = static_cast<double>(benchmark.getMeasuredFrames());
+    const double stepsPerSecond = steps / run.elapsed;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Steps:          " << benchmark.getMeasuredFrames() << " in " << run.elapsed << " s" << std::endl;
+    std::cout << "Steps/s:        " << stepsPerSecond << std::endl;
+    // Pairwise interactions only mean something for the direct sum; the
+    // tree and the mesh do far fewer, and n per evaluation would hide their cost
+    if (simulation.getForceMethod() == ForceMethod::Direct) {
+        const double interactions = static_cast<double>(run.evaluations) * static_cast<double>(n);
+        std::cout << "Interactions/s: " << std::setprecision(3) << interactions / run.elapsed / 1e9 << " G"
+                  << std::endl;
+    }
+    if (run.reorders > 0) {
+        std::cout << "Reordering:     " << run.reorders << " " << curveName(simulation.getReorderSettings().curve)
+                  << " sort(s), " << run.reorderSeconds * 1e3 / run.reorders << " ms each, "
+                  << std::setprecision(2) << 100.0 * run.reorderSeconds / run.elapsed << "% of the run" << std::endl;
+    }
+    benchmark.printSummary(std::cout);
+
+    if (profile) {
+        Profiler::printSummary(std::cout);
+        Profiler::writeChromeTrace(settings.profilePath);
+    }
+
+    // Same results file as the windowed runs, one step per frame
+    benchmark.saveResults(settings.resultsPath);
+}
+
+int runBenchmark(const Settings& settings) {
+    Simulation simulation(G, settings.softening, settings.dt, WIDTH, HEIGHT);
+    simulation.setForceMethod(settings.forceMethod);
+    simulation.setIntegrator(settings.integrator);
+    simulation.setReorderSettings(settings.reorder);
+    simulation.setAffinity(settings.affinity);
+    if (settings.restorePath.empty()) {
+        simulation.initializeBodies(settings.numBodies, settings.initialConditions);
+    } else {
+        // Restored on the first backend, whose threads first-touch the arrays
+        simulation.setBackend(settings.backends.front());
+        std::string error;
+        Clock::time_point start = Clock::now();
+        if (!simulation.loadCheckpoint(settings.restorePath, error)) {
+            std::cerr << "Error: " << error << "." << std::endl;
+            return 1;
+        }
+        std::cout << "Restored " << simulation.getStore().size() << " bodies at step "
+                  << simulation.getStepCount() << " from " << settings.restorePath << " in "
+                  << std::chrono::duration<double, std::milli>(Clock::now() - start).count() << " ms"
+                  << std::endl;
+    }
+
+    TrajectoryWriter trajectory;
+    if (!settings.trajectoryPath.empty()) {
+        std::string error;
+        if (!trajectory.open(settings.trajectoryPath, settings.trajectory, error)) {
+            std::cerr << "Error: " << error << "." << std::endl;
+            return 1;
+        }
+        simulation.setTrajectoryWriter(&trajectory);
+    }
+
+    // Each backend picks up the bodies where the previous one left them
+    for (const std::string& backend : settings.backends) {
+        simulation.setBackend(backend);
+        benchmarkBackend(simulation, settings);
+    }
+    simulation.setTrajectoryWriter(nullptr);
+    trajectory.close();
+
+    if (!settings.checkpointPath.empty()) {
+        CheckpointWriter writer;
+        simulation.saveCheckpoint(writer, settings.checkpointPath);
+        writer.wait();
+    }
+    return 0;
+}
+
+// Processors the thread counts of a study default to
+int processorCount() {
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// Mean duration of one phase on one thread in one step, in milliseconds
+double phaseMs(const std::map<std::string, Profiler::PhaseTotal>& totals, const char* phase) {
+    auto it = totals.find(phase);
+    if (it == totals.end() || it->second.count == 0) return 0.0;
+    return it->second.nanoseconds / 1e6 / it->second.count;
+}
+
+// Runs every size at every thread count. Strong scaling keeps the size;
+// weak scaling grows it so each thread keeps the work of the first run:
+// with the thread count for the near-linear solvers, with its square root
+// for the quadratic direct sum.
+//
+// Per configuration the CSV records the p50 step time, the speedup and
+// parallel efficiency against the first thread count, and the mean time one
+// thread spends per step in the parallel force loop and in the reduction of
+// the per-thread buffers (the symmetric direct sum only).
+int runScalingStudy(const Settings& settings, const std::string& backend) {
+    const bool weak = settings.scaling == "weak";
+    std::vector<int> threadCounts = settings.threadCounts;
+    if (threadCounts.empty()) {
+        const int cores = processorCount();
+        for (int t = 1; t < cores; t *= 2) threadCounts.push_back(t);
+        threadCounts.push_back(cores);
+    }
+    std::vector<int> sizes = settings.sizes;
+    if (sizes.empty()) sizes.push_back(settings.numBodies);
+
+    std::ifstream check(settings.scalingPath);
+    const bool fileExists = check.good();
+    check.close();
+    std::ofstream csv(settings.scalingPath, std::ios::app);
+    if (!csv.is_open()) {
+        std::cerr << "Error: Could not open " << settings.scalingPath << " for writing." << std::endl;
+        return 1;
+    }
+    if (!fileExists) {
+        csv << "Mode,Implementation,Solver,Integrator,BaseBodies,NumBodies,Threads,StepsPerSec,"
+               "P50Ms,Speedup,Efficiency,ForceMs,ReduceMs,OtherMs,CPU\n";
+    }
+
+    const std::string cpu = cpuModelName();
+    std::cout << backend << " backend " << settings.scaling << " scaling study, "
+              << forceMethodName(settings.forceMethod) << ", kernel " << forceKernelName()
+              << ", " << processorCount() << " cores" << std::endl;
+    std::cout << std::setw(8) << "Bodies" << std::setw(8) << "Threads" << std::setw(11) << "p50 ms"
+              << std::setw(9) << "Speedup" << std::setw(11) << "Efficiency" << std::setw(11) << "Force ms"
+              << std::setw(11) << "Reduce ms" << std::setw(10) << "Other ms" << std::endl;
+
+    Profiler::setThreadName("main");
+    for (int baseBodies : sizes) {
+        double baseStep = 0.0;
+        int baseThreads = 0;
+        for (int threads : threadCounts) {
+            double growth = 1.0;
+            if (weak && baseThreads > 0) {
+                growth = static_cast<double>(threads) / baseThreads;
+                if (settings.forceMethod == ForceMethod::Direct) growth = std::sqrt(growth);
+            }
+            const int numBodies = std::max(2, static_cast<int>(std::lround(baseBodies * growth)));
+
+            Simulation simulation(G, settings.softening, settings.dt, WIDTH, HEIGHT);
+            simulation.setForceMethod(settings.forceMethod);
+            simulation.setIntegrator(settings.integrator);
+            simulation.setReorderSettings(settings.reorder);
+            simulation.setAffinity(settings.affinity);
+            simulation.setBackend(backend);
+            simulation.setThreadCount(std::max(1, threads));
+            simulation.initializeBodies(numBodies, settings.initialConditions);
+            const char* implementation = simulation.getBackend().label();
+
+            Benchmark benchmark(implementation, numBodies);
+            Run run = runMeasured(simulation, benchmark, settings, true);
+            const double stepMs = benchmark.getHistogram().percentile(50) * 1e3;
+            const double meanMs = benchmark.getHistogram().getMean() * 1e3;
+            const double stepsPerSecond = benchmark.getMeasuredFrames() / run.elapsed;
+
+            if (baseThreads == 0) {
+                baseStep = stepMs;
+                baseThreads = threads;
+            }
+            // Weak scaling holds the work per thread, so ideally the step
+            // time stays flat; its speedup is the scaled one
+            double efficiency = weak ? baseStep / stepMs
+                                     : baseStep * baseThreads / (stepMs * threads);
+            double speedup = efficiency * threads / baseThreads;
+
+            std::map<std::string, Profiler::PhaseTotal> totals = Profiler::phaseTotals();
+            double forceMs = phaseMs(totals, "direct sum") + phaseMs(totals, "direct pairs") +
+                             phaseMs(totals, "direct rows") + phaseMs(totals, "tree walk");
+            double reduceMs = phaseMs(totals, "reduce");
+            double otherMs = std::max(0.0, meanMs - forceMs - reduceMs);
+
+            std::cout << std::fixed << std::setprecision(3)
+                      << std::setw(8) << numBodies << std::setw(8) << threads << std::setw(11) << stepMs
+                      << std::setprecision(2) << std::setw(9) << speedup << std::setw(11) << efficiency
+                      << std::setprecision(3) << std::setw(11) << forceMs << std::setw(11) << reduceMs
+                      << std::setw(10) << otherMs << std::endl;
+            csv << settings.scaling << "," << implementation << "," << forceMethodName(settings.forceMethod)
+                << "," << integratorName(settings.integrator) << "," << baseBodies << "," << numBodies
+                << "," << threads << std::fixed << std::setprecision(2) << "," << stepsPerSecond
+                << std::setprecision(4) << "," << stepMs << "," << speedup << "," << efficiency
+                << "," << forceMs << "," << reduceMs << "," << otherMs
+                << "," << csvField(cpu) << "\n";
+        }
+    }
+    std::cout << "Scaling results appended to " << settings.scalingPath << std::endl;
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+
+    std::vector<std::string> args;
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (arg.rfind("--", 0) != 0) {
+            args.push_back(arg);
+            continue;
+        }
+
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+        std::string value = (eq == std::string::npos) ? "" : arg.substr(eq + 1);
+
+        try {
+            if (key == "backend") {
+                for (const std::string& name : splitList(value)) {
+                    const std::string backend = resolveForceSolverName(name);
+                    if (backend.empty()) {
+                        std::cout << "Unknown backend '" << name << "'. Skipping it." << std::endl;
+                    } else {
+                        settings.backends.push_back(backend);
+                    }
+                }
+            } else if (key == "ic") {
+                if (!parseDistribution(value, settings.initialConditions.distribution)) {
+                    std::cout << "Unknown initial conditions '" << value << "'. Using disk." << std::endl;
+                    settings.initialConditions.distribution = Distribution::Disk;
+                }
+            } else if (key == "seed") {
+                settings.initialConditions.seed = std::stoull(value);
+            } else if (key == "steps") {
+                settings.fixedSteps = std::stol(value);
+            } else if (key == "dt") {
+                settings.dt = std::stof(value);
+            } else if (key == "softening") {
+                settings.softening = std::stof(value);
+            } else if (key == "solver") {
+                if (value == "barnes-hut" || value == "bh") {
+                    settings.forceMethod = ForceMethod::BarnesHut;
+                } else if (value == "pm" || value == "particle-mesh") {
+                    settings.forceMethod = ForceMethod::ParticleMesh;
+                } else if (value != "direct") {
+                    std::cout << "Unknown solver '" << value << "'. Using direct sum." << std::endl;
+                }
+            } else if (key == "integrator") {
+                if (!parseIntegrator(value, settings.integrator)) {
+                    std::cout << "Unknown integrator '" << value << "'. Using Euler." << std::endl;
+                    settings.integrator = Integrator::Euler;
+                }
+            } else if (key == "reorder") {
+                if (!parseCurve(value, settings.reorder.curve)) {
+                    std::cout << "Unknown curve '" << value << "'. Using hilbert." << std::endl;
+                    settings.reorder.curve = SpaceFillingCurve::Hilbert;
+                }
+            } else if (key == "reorder-interval") {
+                settings.reorder.interval = std::max(0, std::stoi(value));
+            } else if (key == "affinity") {
+                if (!parseAffinity(value, settings.affinity)) {
+                    std::cout << "Unknown affinity '" << value << "'. Using none." << std::endl;
+                    settings.affinity = AffinityMode::None;
+                }
+            } else if (key == "results" || key == "csv") {
+                settings.resultsPath = value;
+            } else if (key == "profile") {
+                settings.profilePath = value.empty() ? "trace.json" : value;
+            } else if (key == "restore") {
+                settings.restorePath = value;
+            } else if (key == "checkpoint") {
+                settings.checkpointPath = value.empty() ? "checkpoint.nbody" : value;
+            } else if (key == "trajectory") {
+                settings.trajectoryPath = value.empty() ? "trajectory.nbt" : value;
+            } else if (key == "trajectory-interval") {
+                settings.trajectory.interval = std::max(1, std::stoi(value));
+            } else if (key == "trajectory-encoding") {
+                if (!parseTrajectoryEncoding(value, settings.trajectory.encoding)) {
+                    std::cout << "Unknown trajectory encoding '" << value << "'. Using delta." << std::endl;
+                    settings.trajectory.encoding = TrajectoryEncoding::Delta;
+                }
+            } else if (key == "trajectory-precision") {
+                settings.trajectory.precision = std::stof(value);
+                if (settings.trajectory.precision <= 0.0f) settings.trajectory.precision = 1e-3f;
+            } else if (key == "scaling") {
+                settings.scaling = value.empty() ? "strong" : value;
+                if (settings.scaling != "strong" && settings.scaling != "weak") {
+                    std::cout << "Unknown scaling mode '" << value << "'. Using strong." << std::endl;
+                    settings.scaling = "strong";
+                }
+            } else if (key == "threads") {
+                settings.threadCounts = parseList(value);
+            } else if (key == "sizes") {
+                settings.sizes = parseList(value);
+            } else if (key == "scaling-results") {
+                settings.scalingPath = value;
+            } else {
+                std::cout << "Unknown option: " << arg << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } catch (const std::exception& e) {
+            std::cout << "Invalid value for --" << key << ". Using default." << std::endl;
+        }
+    }
+
+    if (args.size() > 0) {
+        try {
+            settings.numBodies = std::max(2, std::stoi(args[0]));
+        } catch (const std::exception& e) {
+            std::cout << "Invalid number of bodies. Using default: 1000" << std::endl;
+        }
+    }
+    if (args.size() > 1) {
+        try {
+            settings.duration = std::stod(args[1]);
+            if (settings.duration <= 0.0) settings.duration = 10.0;
+        } catch (const std::exception& e) {
+            std::cout << "Invalid duration. Using default: 10" << std::endl;
+        }
+    }
+
+    if (settings.backends.empty()) settings.backends.push_back(forceSolverForProgram(argv[0]));
+
+    if (!settings.scaling.empty()) {
+        for (const std::string& backend : settings.backends) {
+            if (backend == "serial") {
+                std::cout << "Scaling studies need a parallel backend (openmp or pool)." << std::endl;
+                return 1;
+            }
+            if (runScalingStudy(settings, backend) != 0) return 1;
+        }
+        return 0;
+    }
+    return runBenchmark(settings);
+}
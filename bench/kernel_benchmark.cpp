@@ -0,0 +1,111 @@
+// Throughput of the direct-sum kernel, with and without cache blocking,
+// from 1k to 200k bodies. Only the kernel is linked, no SFML needed.
+#include "ForceKernel.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Result {
+    double interactionsPerSecond;
+    double seconds;
+};
+
+// Every target sums over all n sources; large n only run a slice of the
+// targets, which still streams the full source array per target row
+Result run(size_t n, bool blocked, const KernelTiles& tiles, double budget) {
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<float> posDist(0.0f, 1000.0f);
+    std::uniform_real_distribution<float> massDist(20.0f, 100.0f);
+
+    std::vector<float> x(n), y(n), mass(n), ax(n, 0.0f), ay(n, 0.0f);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = posDist(gen);
+        y[i] = posDist(gen);
+        mass[i] = massDist(gen);
+    }
+
+    // About 2e8 interactions per repetition, at least one full target block
+    size_t targets = std::max<size_t>(tiles.targetBlock, static_cast<size_t>(2e8) / n);
+    targets = std::min(targets, n);
+
+    size_t reps = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    do {
+        if (blocked) {
+            accumulateAccelerationsBlocked(x.data(), y.data(), targets, x.data(), y.data(), mass.data(),
+                                           n, 1.0f, 4.0f, ax.data(), ay.data(), tiles);
+        } else {
+            accumulateAccelerations(x.data(), y.data(), targets, x.data(), y.data(), mass.data(),
+                                    n, 1.0f, 4.0f, ax.data(), ay.data());
+        }
+        reps++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < budget);
+
+    double interactions = static_cast<double>(reps) * targets * n;
+    return Result{interactions / elapsed, elapsed};
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000};
+    KernelTiles tiles{0, 0};
+    double budget = 1.0;
+    std::string csvPath;
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg.rfind("--tile=", 0) == 0) {
+            std::string value = arg.substr(7);
+            size_t comma = value.find(',');
+            tiles.targetBlock = std::stoul(value.substr(0, comma));
+            tiles.sourceBlock = (comma == std::string::npos) ? 0 : std::stoul(value.substr(comma + 1));
+        } else if (arg.rfind("--budget=", 0) == 0) {
+            budget = std::stod(arg.substr(9));
+        } else if (arg.rfind("--csv=", 0) == 0) {
+            csvPath = arg.substr(6);
+        } else if (arg == "-h" || arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " [--tile=TARGETS,SOURCES] [--budget=SECONDS] [--csv=FILE]\n";
+            return 0;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    tiles = resolveKernelTiles(tiles);
+    std::cout << "Kernel: " << forceKernelName() << ", blocks of " << tiles.targetBlock
+              << " targets x " << tiles.sourceBlock << " sources" << std::endl;
+    std::cout << std::setw(8) << "Bodies" << std::setw(18) << "Streamed Gint/s"
+              << std::setw(18) << "Blocked Gint/s" << std::endl;
+
+    std::ofstream csv;
+    if (!csvPath.empty()) {
+        csv.open(csvPath);
+        csv << "Kernel,NumBodies,TargetBlock,SourceBlock,StreamedInteractionsPerSec,BlockedInteractionsPerSec\n";
+    }
+
+    for (size_t n : sizes) {
+        Result streamed = run(n, false, tiles, budget);
+        Result blocked = run(n, true, tiles, budget);
+
+        std::cout << std::setw(8) << n << std::fixed << std::setprecision(3)
+                  << std::setw(18) << streamed.interactionsPerSecond / 1e9
+                  << std::setw(18) << blocked.interactionsPerSecond / 1e9 << std::endl;
+        if (csv.is_open()) {
+            csv << forceKernelName() << "," << n << "," << tiles.targetBlock << "," << tiles.sourceBlock
+                << "," << std::fixed << std::setprecision(0) << streamed.interactionsPerSecond
+                << "," << blocked.interactionsPerSecond << "\n";
+        }
+    }
+    return 0;
+}
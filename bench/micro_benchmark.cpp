@@ -0,0 +1,374 @@
+// Times each physics path in isolation, from 100 to 1M bodies: the blocked
+// direct-sum kernel alone, Simulation::update with Euler, one integrator step,
+// initializeBodies, a space-filling-curve sort of the store and
+// Barnes-Hut steps with and without that sorting. The update cases run on the backend given
+// by --backend, or implied by the micro_benchmark_serial, _omp and _pool links.
+//
+// Every case runs repeated trials and reports the mean cost per item (one
+// pairwise interaction, or one body for initialization) with a 95% confidence
+// interval, plus GFLOP/s and the bytes a trial must at least move.
+#include "Simulation.h"
+#include "ForceKernel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Force backend of every simulation the cases create, set once in main
+std::string backend = defaultForceSolver();
+
+// Same world as the windowed binaries
+const float G = 1.0f;
+const float WIDTH = 1920.0f;
+const float HEIGHT = 1080.0f;
+const float SOFTENING = 2.0f;
+const float DT = 0.001f;
+
+// Floating point operations of one interaction as the SIMD kernels compute it:
+// 2 differences, 4 for the squared distance, 6 for rsqrt and its Newton step,
+// 3 for m / r^3 and 4 to accumulate
+const double FLOPS_PER_INTERACTION = 19.0;
+
+// Bytes of one body in the store: x, y, vx, vy, ax, ay, mass, radius, color, id
+const double BYTES_PER_BODY = 10 * 4.0;
+
+// Smallest traffic of a blocked direct sum: the sources (x, y, mass) stream
+// once per target block, the targets (x, y read, ax, ay read and written) once
+double kernelBytes(size_t targets, size_t sources, const KernelTiles& tiles) {
+    double targetBlocks = std::ceil(static_cast<double>(targets) / tiles.targetBlock);
+    return targetBlocks * sources * 12.0 + targets * 24.0;
+}
+
+// Two-sided 95% Student t quantile for the given degrees of freedom
+double tQuantile95(int degrees) {
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                                   2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+                                   2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+                                   2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (degrees < 1) return 0.0;
+    if (degrees <= 30) return table[degrees - 1];
+    return 1.96;
+}
+
+// What one repetition of a case did
+struct Work {
+    double items;    // Interactions, or bodies for initialization
+    double flops;
+    double bytes;
+};
+
+struct Stats {
+    int trials;
+    double nsPerItem;
+    double nsPerItemCI;
+    double gflops;
+    double bytesPerItem;
+    double gbPerSecond;
+};
+
+// Runs `trials` timed trials of at least one repetition and trialSeconds each,
+// after one untimed repetition, and summarizes the time per item
+Stats measure(const std::function<Work()>& repeat, int trials, double trialSeconds) {
+    using Clock = std::chrono::steady_clock;
+    repeat();
+
+    std::vector<double> nsPerItem;
+    double totalSeconds = 0.0, totalFlops = 0.0, totalBytes = 0.0, totalItems = 0.0;
+    for (int t = 0; t < trials; t++) {
+        Work work{0.0, 0.0, 0.0};
+        Clock::time_point start = Clock::now();
+        double elapsed = 0.0;
+        do {
+            Work w = repeat();
+            work.items += w.items;
+            work.flops += w.flops;
+            work.bytes += w.bytes;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < trialSeconds);
+
+        nsPerItem.push_back(elapsed * 1e9 / work.items);
+        totalSeconds += elapsed;
+        totalFlops += work.flops;
+        totalBytes += work.bytes;
+        totalItems += work.items;
+    }
+
+    double mean = 0.0;
+    for (double v : nsPerItem) mean += v;
+    mean /= trials;
+    double variance = 0.0;
+    for (double v : nsPerItem) variance += (v - mean) * (v - mean);
+    variance = trials > 1 ? variance / (trials - 1) : 0.0;
+
+    Stats stats;
+    stats.trials = trials;
+    stats.nsPerItem = mean;
+    stats.nsPerItemCI = tQuantile95(trials - 1) * std::sqrt(variance / trials);
+    stats.gflops = totalFlops / totalSeconds / 1e9;
+    stats.bytesPerItem = totalBytes / totalItems;
+    stats.gbPerSecond = totalBytes / totalSeconds / 1e9;
+    return stats;
+}
+
+// The blocked kernel on its own, single threaded. Large sizes run a slice of
+// about 2e8 interactions; the slice may be smaller than one target block,
+// which still streams every source once.
+Stats benchKernel(size_t n, const KernelTiles& tiles, int trials, double trialSeconds) {
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<float> posDist(0.0f, 1000.0f);
+    std::uniform_real_distribution<float> massDist(20.0f, 100.0f);
+
+    std::vector<float> x(n), y(n), mass(n), ax(n, 0.0f), ay(n, 0.0f);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = posDist(gen);
+        y[i] = posDist(gen);
+        mass[i] = massDist(gen);
+    }
+
+    size_t targets = std::max<size_t>(64, static_cast<size_t>(2e8) / n);
+    targets = std::min(targets, n);
+    const double interactions = static_cast<double>(targets) * n;
+    const double bytes = kernelBytes(targets, n, tiles);
+
+    return measure([&]() {
+        accumulateAccelerationsBlocked(x.data(), y.data(), targets, x.data(), y.data(), mass.data(),
+                                       n, G, SOFTENING * SOFTENING, ax.data(), ay.data(), tiles);
+        return Work{interactions, interactions * FLOPS_PER_INTERACTION, bytes};
+    }, trials, trialSeconds);
+}
+
+// Whole direct-sum steps of the backend's Simulation. The step moves at
+// least the kernel traffic of every force evaluation plus one read and write
+// of the body state.
+Stats benchUpdate(int n, Integrator integrator, const KernelTiles& tiles, int trials, double trialSeconds) {
+    Simulation simulation(G, SOFTENING, DT, WIDTH, HEIGHT);
+    simulation.setBackend(backend);
+    simulation.setIntegrator(integrator);
+    simulation.setKernelTiles(tiles);
+    simulation.initializeBodies(n);
+    const size_t bodies = simulation.getStore().size();
+
+    return measure([&]() {
+        uint64_t before = simulation.getForceEvaluations();
+        simulation.update();
+        double evaluations = static_cast<double>(simulation.getForceEvaluations() - before);
+        double interactions = evaluations * bodies;
+        double bytes = evaluations / bodies * kernelBytes(bodies, bodies, tiles) + 2.0 * bodies * BYTES_PER_BODY;
+        return Work{interactions, interactions * FLOPS_PER_INTERACTION, bytes};
+    }, trials, trialSeconds);
+}
+
+// Filling the store from scratch, which writes every field of every body once
+Stats benchInitialize(int n, int trials, double trialSeconds) {
+    Simulation simulation(G, SOFTENING, DT, WIDTH, HEIGHT);
+    simulation.setBackend(backend);
+
+    return measure([&]() {
+        simulation.initializeBodies(n);
+        double bodies = static_cast<double>(simulation.getStore().size());
+        return Work{bodies, 0.0, bodies * BYTES_PER_BODY};
+    }, trials, trialSeconds);
+}
+
+// Sorting the store along the curve: keys and sort, then every array is
+// read and written once. Measured on an already sorted store, as the
+// periodic sorts of a running simulation see it.
+Stats benchReorder(int n, SpaceFillingCurve curve, int trials, double trialSeconds) {
+    Simulation simulation(G, SOFTENING, DT, WIDTH, HEIGHT);
+    simulation.setBackend(backend);
+    simulation.setReorderSettings(ReorderSettings{curve, 0});
+    simulation.initializeBodies(n);
+
+    return measure([&]() {
+        simulation.reorderBodies();
+        double bodies = static_cast<double>(simulation.getStore().size());
+        return Work{bodies, 0.0, 2.0 * bodies * BYTES_PER_BODY};
+    }, trials, trialSeconds);
+}
+
+// Barnes-Hut steps per body, in the order initializeBodies leaves the
+// bodies or sorted periodically; the sorted run pays for its sorts
+Stats benchTree(int n, const ReorderSettings& reorder, int trials, double trialSeconds) {
+    Simulation simulation(G, SOFTENING, DT, WIDTH, HEIGHT);
+    simulation.setBackend(backend);
+    simulation.setForceMethod(ForceMethod::BarnesHut);
+    simulation.setReorderSettings(reorder);
+    simulation.initializeBodies(n);
+
+    return measure([&]() {
+        simulation.update();
+        double bodies = static_cast<double>(simulation.getStore().size());
+        return Work{bodies, 0.0, 2.0 * bodies * BYTES_PER_BODY};
+    }, trials, trialSeconds);
+}
+
+std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) sizes.push_back(std::max<size_t>(2, std::stoul(item)));
+    }
+    return sizes;
+}
+
+void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [options]\n";
+    std::cout << "Options:\n";
+    std::cout << "  --backend=serial|openmp|pool  Backend of the simulation cases (default: openmp)\n";
+    std::cout << "  --sizes=N1,N2,...           Body counts (default: 100,1000,10000,100000,1000000)\n";
+    std::cout << "  --trials=N                  Timed trials per case (default: 5)\n";
+    std::cout << "  --trial-time=SECONDS        Minimum time per trial (default: 0.2)\n";
+    std::cout << "  --max-direct=N              Largest body count for whole direct-sum steps (default: 20000)\n";
+    std::cout << "  --max-tree=N                Largest body count for Barnes-Hut steps (default: 200000)\n";
+    std::cout << "  --integrator=NAME           Integrator of the integrator case (default: leapfrog)\n";
+    std::cout << "  --reorder=morton|hilbert    Curve of the sorting cases (default: hilbert)\n";
+    std::cout << "  --tile=TARGETS,SOURCES      Kernel block sizes (default: from the cache sizes)\n";
+    std::cout << "  --csv=FILE                  Write the results as CSV\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {100, 1000, 10000, 100000, 1000000};
+    int trials = 5;
+    double trialSeconds = 0.2;
+    size_t maxDirect = 20000;
+    size_t maxTree = 200000;
+    ReorderSettings sorted;
+    Integrator stepIntegrator = Integrator::Leapfrog;
+    std::string stepCase = "leapfrog";
+    KernelTiles tiles{0, 0};
+    std::string csvPath;
+    backend = forceSolverForProgram(argv[0]);
+
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = (eq == std::string::npos) ? "" : arg.substr(eq + 1);
+
+        try {
+            if (key == "--backend") {
+                if (resolveForceSolverName(value).empty()) {
+                    std::cout << "Unknown backend '" << value << "'. Using " << backend << "." << std::endl;
+                } else {
+                    backend = resolveForceSolverName(value);
+                }
+            } else if (key == "--sizes") {
+                sizes = parseSizes(value);
+            } else if (key == "--trials") {
+                trials = std::max(1, std::stoi(value));
+            } else if (key == "--trial-time") {
+                trialSeconds = std::max(0.0, std::stod(value));
+            } else if (key == "--max-direct") {
+                maxDirect = std::stoul(value);
+            } else if (key == "--max-tree") {
+                maxTree = std::stoul(value);
+            } else if (key == "--reorder") {
+                if (!parseCurve(value, sorted.curve) || sorted.curve == SpaceFillingCurve::None) {
+                    std::cout << "Unknown curve '" << value << "'. Using hilbert." << std::endl;
+                    sorted.curve = SpaceFillingCurve::Hilbert;
+                }
+            } else if (key == "--integrator") {
+                if (parseIntegrator(value, stepIntegrator)) {
+                    stepCase = value;
+                } else {
+                    std::cout << "Unknown integrator '" << value << "'. Using leapfrog." << std::endl;
+                    stepIntegrator = Integrator::Leapfrog;
+                }
+            } else if (key == "--tile") {
+                size_t comma = value.find(',');
+                tiles.targetBlock = std::stoul(value.substr(0, comma));
+                tiles.sourceBlock = (comma == std::string::npos) ? 0 : std::stoul(value.substr(comma + 1));
+            } else if (key == "--csv") {
+                csvPath = value;
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } catch (const std::exception& e) {
+            std::cout << "Invalid value for " << key << ". Using default." << std::endl;
+        }
+    }
+
+    tiles = resolveKernelTiles(tiles);
+    int threads = 1;
+    std::string implementation;
+    {
+        Simulation probe(G, SOFTENING, DT, WIDTH, HEIGHT);
+        probe.setBackend(backend);
+        threads = probe.getThreadCount();
+        implementation = probe.getBackend().label();
+    }
+    std::cout << implementation << " micro-benchmark, " << threads << " thread(s), kernel "
+              << forceKernelName() << ", " << trials << " trials of " << trialSeconds << " s" << std::endl;
+    std::cout << std::left << std::setw(12) << "Case" << std::right << std::setw(9) << "Bodies"
+              << std::setw(22) << "ns/item (95% CI)" << std::setw(10) << "GFLOP/s"
+              << std::setw(10) << "B/item" << std::setw(9) << "GB/s" << std::endl;
+
+    std::ofstream csv;
+    if (!csvPath.empty()) {
+        csv.open(csvPath);
+        if (!csv.is_open()) {
+            std::cerr << "Error: Could not open " << csvPath << " for writing." << std::endl;
+        } else {
+            csv << "Implementation,Case,NumBodies,Threads,Kernel,Trials,NsPerItem,NsPerItemCI95,"
+                   "GFlopsPerSec,BytesPerItem,GBytesPerSec\n";
+        }
+    }
+
+    auto report = [&](const std::string& name, size_t n, const Stats& s) {
+        std::ostringstream interval;
+        interval << std::fixed << std::setprecision(3) << s.nsPerItem << " +- " << s.nsPerItemCI;
+        std::cout << std::left << std::setw(12) << name << std::right << std::setw(9) << n
+                  << std::setw(22) << interval.str() << std::fixed << std::setprecision(2)
+                  << std::setw(10) << s.gflops << std::setprecision(3) << std::setw(10) << s.bytesPerItem
+                  << std::setw(9) << s.gbPerSecond << std::endl;
+        if (csv.is_open()) {
+            csv << implementation << "," << name << "," << n << "," << threads << "," << forceKernelName()
+                << "," << s.trials << std::setprecision(4) << "," << s.nsPerItem << "," << s.nsPerItemCI
+                << "," << s.gflops << "," << s.bytesPerItem << "," << s.gbPerSecond << "\n";
+        }
+    };
+
+    for (size_t n : sizes) {
+        report("kernel", n, benchKernel(n, tiles, trials, trialSeconds));
+
+        // A whole direct-sum step at 1M bodies takes minutes
+        if (n <= maxDirect) {
+            report("update", n, benchUpdate(static_cast<int>(n), Integrator::Euler, tiles, trials, trialSeconds));
+            report(stepCase, n, benchUpdate(static_cast<int>(n), stepIntegrator, tiles, trials, trialSeconds));
+        }
+
+        report("init", n, benchInitialize(static_cast<int>(n), trials, trialSeconds));
+        report(std::string("sort-") + curveName(sorted.curve), n,
+               benchReorder(static_cast<int>(n), sorted.curve, trials, trialSeconds));
+
+        if (n <= maxTree) {
+            Stats unsortedTree = benchTree(static_cast<int>(n), ReorderSettings{SpaceFillingCurve::None, 0},
+                                           trials, trialSeconds);
+            Stats sortedTree = benchTree(static_cast<int>(n), sorted, trials, trialSeconds);
+            report("bh", n, unsortedTree);
+            report(std::string("bh-") + curveName(sorted.curve), n, sortedTree);
+            std::cout << "  Barnes-Hut speedup from " << curveName(sorted.curve) << " order: "
+                      << std::setprecision(2) << unsortedTree.nsPerItem / sortedTree.nsPerItem << "x" << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class ForceSolver;
+
+// Pinning of the force threads (the OpenMP team or the pool workers) to
+// cores. Thread numbers are assigned node by node, so the static loop splits
+// over the body arrays give every NUMA node one contiguous slice, first
+// touched and then used by that node's threads.
+enum class AffinityMode {
+    None,     // Leave placement to the OS
+    Compact,  // Fill the physical cores of one node before the next
+    Spread    // Divide the threads evenly over the nodes
+};
+
+const char* affinityName(AffinityMode mode);
+
+// Parse "none", "compact"/"close" or "spread"; false if unknown
+bool parseAffinity(const std::string& name, AffinityMode& mode);
+
+// Where one thread of the team runs
+struct ThreadPlacement {
+    int thread;
+    int cpu;
+    int node;
+};
+
+// Pin every thread of the backend (the calling thread alone for the serial
+// one) and return where each one ended up
+std::vector<ThreadPlacement> pinThreads(ForceSolver& solver, AffinityMode mode);
+
+// CPU and node each thread of the backend is running on right now
+std::vector<ThreadPlacement> currentPlacement(ForceSolver& solver);
+
+// Number of NUMA nodes the process may run on
+int numaNodeCount();
+
+void printPlacement(std::ostream& out, AffinityMode mode, const std::vector<ThreadPlacement>& placement);
+
+#endif // AFFINITY_H
@@ -0,0 +1,48 @@
+#pragma once
+#ifndef BARNES_HUT_H
+#define BARNES_HUT_H
+
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "ForceKernel.h"
+
+struct BodyStore;
+
+class QuadTree {
+private:
+    struct Node {
+        float centerX, centerY;  // Geometric center of the cell
+        float halfSize;          // Half of the cell's side length
+        float mass;              // Total mass in the cell
+        float comX, comY;        // Center of mass
+        int firstChild;          // Index of the first of 4 children, -1 for leaves
+        int body;                // First body stored in a leaf, -1 if empty
+    };
+
+    // Cells are never split past this depth; coincident bodies share a leaf
+    static constexpr int MAX_DEPTH = 32;
+
+    std::vector<Node> nodes;
+    std::vector<int> nextInLeaf;  // Linked list of bodies sharing a leaf
+    std::vector<float> posX, posY, mass;
+
+    int childIndex(const Node& node, float x, float y) const;
+    void subdivide(int nodeIndex);
+    void insert(int bodyIndex);
+    void computeMassDistribution();
+
+public:
+    // Rebuild the tree over the current body positions
+    void build(const BodyStore& bodies);
+
+    // Approximate acceleration on body i using the opening angle theta
+    sf::Vector2f accelerationOn(size_t i, float theta, float G, float softening) const;
+
+    size_t nodeCount() const { return nodes.size(); }
+};
+
+// Compare Barnes-Hut against the direct sum on a sample of bodies
+ForceError measureBarnesHutError(const BodyStore& bodies, float theta,
+                                 float G, float softening, int samples);
+
+#endif // BARNES_HUT_H
@@ -1,27 +1,107 @@
 #ifndef BENCHMARK_HPP
 #define BENCHMARK_HPP
 
+#include <array>
+#include <cstdint>
+#include <iosfwd>
 #include <string>
-#include <fstream>
+#include <vector>
+
+// Fixed-size log-linear histogram of frame times: 16 buckets per power of two
+// from 1 us up to ~30 min, so percentiles are within ~3% at any frame rate
+// without keeping every sample
+class FrameHistogram {
+private:
+    static constexpr int SUB_BUCKETS = 16;
+    static constexpr int OCTAVES = 31;
+    static constexpr double MIN_SECONDS = 1e-6;
+
+    std::array<uint64_t, SUB_BUCKETS * OCTAVES> buckets{};
+    uint64_t count = 0;
+    double sum = 0.0;
+    double max = 0.0;
+
+    static int bucketOf(double seconds);
+    static double bucketMidpoint(int bucket);
+
+public:
+    void add(double seconds);
+    void clear();
+
+    uint64_t getCount() const { return count; }
+    double getSum() const { return sum; }
+    double getMax() const { return max; }
+    double getMean() const { return count ? sum / count : 0.0; }
+
+    // Frame time at percentile p (0-100), in seconds
+    double percentile(double p) const;
+};
 
 class Benchmark {
+public:
+    // Run settings recorded with every result row
+    struct Metadata {
+        int threads = 1;
+        float dt = 0.0f;
+        float softening = 0.0f;
+        std::string solver;
+        std::string integrator;
+    };
+
 private:
     std::string implementation;
     int numBodies;
-    double totalFPS;
-    int frameCount;
-    
+    Metadata metadata;
+
+    // Warm-up: frames are compared in windows until two consecutive window
+    // means agree, bounded by a frame and a time budget
+    static constexpr int WARMUP_WINDOW = 16;
+    static constexpr double WARMUP_TOLERANCE = 0.05;
+    static constexpr int MAX_WARMUP_FRAMES = 1000;
+    static constexpr double MAX_WARMUP_SECONDS = 5.0;
+
+    bool warmedUp;
+    int warmupFrames;
+    double warmupSeconds;
+    double windowSum;
+    int windowFrames;
+    double previousWindowMean;
+
+    FrameHistogram histogram;
+
+    void writeCsv(const std::string& filename) const;
+    void writeJson(const std::string& filename) const;
+
 public:
     Benchmark(const std::string& impl, int bodies);
-    
-    // Add a frame's FPS measurement
-    void addFrame(double fps);
-    
-    // Save the results to CSV file
-    void saveResults(const std::string& filename = "benchmark_results.csv");
-    
-    // Get average FPS so far
+
+    void setMetadata(const Metadata& m) { metadata = m; }
+    const Metadata& getMetadata() const { return metadata; }
+    const std::string& getImplementation() const { return implementation; }
+    int getNumBodies() const { return numBodies; }
+
+    // Add the wall time of one frame (one simulation step)
+    void addFrameTime(double seconds);
+
+    bool isWarmedUp() const { return warmedUp; }
+    int getWarmupFrames() const { return warmupFrames; }
+    uint64_t getMeasuredFrames() const { return histogram.getCount(); }
+    const FrameHistogram& getHistogram() const { return histogram; }
+
+    // Frames per second over the measured (post warm-up) frames
     double getAverageFPS() const;
+
+    void printSummary(std::ostream& out) const;
+
+    // Append the results; a name ending in .json writes one JSON object per
+    // line, anything else a CSV row
+    void saveResults(const std::string& filename = "benchmark_results.csv");
 };
 
+// CPU model string from /proc/cpuinfo, "unknown" if unavailable
+std::string cpuModelName();
+
+// Quoted CSV field, so a comma in a CPU name can't shift columns
+std::string csvField(const std::string& text);
+
 #endif // BENCHMARK_HPP
@@ -4,11 +4,12 @@
 
 #include <SFML/Graphics.hpp>
 
+// A single body as a value. The simulation keeps its bodies in a BodyStore;
+// Body is what gets handed out when reading them one at a time.
 class Body {
 private:
     sf::Vector2f position;
     sf::Vector2f velocity;
-    sf::Vector2f acceleration;
     float mass;
     float radius;
     sf::Color color;
@@ -23,15 +24,6 @@ public:
     float getMass() const;
     float getRadius() const;
     sf::Color getColor() const;
-
-    // Apply force to calculate new acceleration
-    void applyForce(const sf::Vector2f& force);
-
-    // Update position and velocity using current acceleration
-    void update(float dt);
-
-    // Reset acceleration to zero (called at beginning of each frame)
-    void resetAcceleration();
 };
 
 #endif // BODY_H
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef BODY_RENDERER_H
+#define BODY_RENDERER_H
+
+#include <SFML/Graphics.hpp>
+
+struct BodySnapshot;
+
+// Draws every body as a textured quad from one vertex array, so a frame costs
+// a single draw call instead of one sf::CircleShape per body. The quads are
+// rebuilt only when a new snapshot arrives and can be drawn to any target.
+class BodyRenderer {
+private:
+    static constexpr unsigned TEXTURE_SIZE = 64;
+    static constexpr std::size_t VERTICES_PER_BODY = 6;   // Two triangles
+
+    sf::VertexArray vertices;
+    sf::Texture circleTexture;     // White anti-aliased disc, tinted per vertex
+
+    void createCircleTexture();
+
+public:
+    BodyRenderer();
+
+    // Rebuild the quads from a snapshot's positions, radii and colors
+    void update(const BodySnapshot& bodies);
+
+    void draw(sf::RenderTarget& target) const;
+};
+
+#endif // BODY_RENDERER_H
@@ -0,0 +1,135 @@
+#pragma once
+#ifndef BODY_STORE_H
+#define BODY_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <utility>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "Body.h"
+
+// Allocator returning cache-line aligned blocks so the hot arrays start on a
+// vector register boundary
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() noexcept = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, std::size_t) noexcept {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    // Default-initialize on resize: floats are left unwritten, so each page is
+    // first touched, and placed on a NUMA node, by the thread that fills it
+    template <typename U>
+    void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Structure-of-arrays body storage. The arrays touched by the force loop are
+// contiguous and aligned; radius and color are only read when drawing.
+struct BodyStore {
+    // Hot physics state
+    AlignedVector<float> x, y;
+    AlignedVector<float> vx, vy;
+    AlignedVector<float> ax, ay;
+    AlignedVector<float> mass;
+
+    // Render-only attributes
+    std::vector<float> radius;
+    std::vector<sf::Color> color;
+
+    // Stable identity, kept when the bodies are reordered. Ids are handed
+    // out in insertion order and never reused, so they stay unique when
+    // bodies are removed.
+    std::vector<uint32_t> id;
+    uint32_t nextId = 0;
+
+    std::size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+
+    void clear();
+    void reserve(std::size_t n);
+
+    // Grow or shrink every array; new hot elements are left unwritten, so
+    // whichever thread fills them first decides their NUMA node
+    void resize(std::size_t n);
+    void emplace_back(sf::Vector2f pos, sf::Vector2f vel, float m, float r, sf::Color c);
+    void push_back(const Body& body);
+
+    // Append every body of the batch under new ids; the batch's ids are ignored
+    void append(const BodyStore& batch);
+
+    // Remove body i by moving the last body into its place
+    void swapRemove(std::size_t i);
+
+    // Assemble the body at index i as a value
+    Body get(std::size_t i) const;
+
+    // Move every array into the order given; order[k] is the index of the
+    // body that ends up at k
+    void permute(const std::vector<uint32_t>& order);
+};
+
+// Read-only view over a BodyStore that iterates like a std::vector<Body>,
+// producing Body values on the fly
+class BodyView {
+private:
+    const BodyStore* store;
+
+public:
+    class const_iterator {
+    private:
+        const BodyStore* store;
+        std::size_t index;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Body;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Body;
+
+        const_iterator(const BodyStore* s, std::size_t i) : store(s), index(i) {}
+        Body operator*() const { return store->get(index); }
+        const_iterator& operator++() { ++index; return *this; }
+        const_iterator operator++(int) { const_iterator tmp = *this; ++index; return tmp; }
+        bool operator==(const const_iterator& other) const { return index == other.index; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+    };
+
+    explicit BodyView(const BodyStore& s) : store(&s) {}
+
+    std::size_t size() const { return store->size(); }
+    bool empty() const { return store->empty(); }
+    Body operator[](std::size_t i) const { return store->get(i); }
+    const_iterator begin() const { return const_iterator(store, 0); }
+    const_iterator end() const { return const_iterator(store, store->size()); }
+
+    // Direct access to the underlying arrays
+    const BodyStore& data() const { return *store; }
+};
+
+#endif // BODY_STORE_H
@@ -0,0 +1,132 @@
+#pragma once
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "BodyStore.h"
+
+// Binary snapshot of a simulation: a fixed header with the parameters,
+// then every body array as raw native-endian data, each starting on a
+// 64-byte boundary so a mapped file can be copied with aligned loads.
+// Files are written by a background thread and read through mmap.
+
+const uint32_t CHECKPOINT_VERSION = 2;
+
+// Body arrays in file order
+enum CheckpointArray : uint32_t {
+    ArrayX, ArrayY, ArrayVx, ArrayVy, ArrayAx, ArrayAy, ArrayMass,
+    ArrayRadius, ArrayColor, ArrayId,
+    CHECKPOINT_ARRAYS
+};
+
+// Simulation state besides the bodies; enums are stored as their values
+struct CheckpointParameters {
+    float gravitationalConstant;
+    float softening;
+    float timeStep;
+    float width;
+    float height;
+    float theta;
+    int32_t forceMethod;
+    int32_t integrator;
+    int32_t directMode;
+    int32_t blockMaxLevel;
+    float blockAccuracy;
+    int32_t reorderCurve;
+    int32_t reorderInterval;
+    int32_t meshGridSize;
+    int32_t meshAssignment;
+    int32_t meshShortRange;
+    uint32_t accelerationsValid;  // ax/ay belong to the stored positions
+    uint32_t nextId;              // First id not handed out yet, removed bodies included
+    uint64_t stepCount;
+    uint64_t forceEvaluations;
+
+    // Where added bodies are drawn from, see InitialConditions
+    int32_t distribution;
+    int32_t initialBodyCount;     // Bodies asked for when generating
+    uint64_t seed;
+    float maxMassSmall;
+    float maxMassBig;
+};
+
+struct CheckpointHeader {
+    char magic[8];                 // "NBODYCKP"
+    uint32_t version;
+    uint32_t byteOrder;            // 0x01020304 as written, to catch foreign files
+    uint64_t headerSize;
+    uint64_t bodyCount;
+    uint64_t fileSize;
+    uint64_t arrayOffset[CHECKPOINT_ARRAYS];
+    CheckpointParameters parameters;
+};
+
+// Write the snapshot to path.tmp and rename it over path, so a crash never
+// leaves a truncated checkpoint behind. False with a message on failure.
+bool writeCheckpoint(const std::string& path, const CheckpointParameters& parameters,
+                     const BodyStore& bodies, std::string& error);
+
+// Read-only mapping of a checkpoint, checked against its header on open
+class MappedCheckpoint {
+public:
+    MappedCheckpoint() = default;
+    ~MappedCheckpoint();
+
+    MappedCheckpoint(const MappedCheckpoint&) = delete;
+    MappedCheckpoint& operator=(const MappedCheckpoint&) = delete;
+
+    bool open(const std::string& path, std::string& error);
+
+    const CheckpointHeader& header() const { return *reinterpret_cast<const CheckpointHeader*>(data); }
+    size_t bodyCount() const { return static_cast<size_t>(header().bodyCount); }
+
+    // Start of one array inside the mapping
+    template <typename T>
+    const T* array(CheckpointArray which) const {
+        return reinterpret_cast<const T*>(data + header().arrayOffset[which]);
+    }
+
+private:
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+};
+
+// Writes one snapshot at a time on its own thread. The snapshot is a copy
+// of the body arrays, so the simulation keeps stepping while it is written.
+class CheckpointWriter {
+public:
+    CheckpointWriter();
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // Queue a snapshot; false if the previous one is still being written
+    bool submit(const std::string& path, const CheckpointParameters& parameters, BodyStore&& bodies);
+
+    bool isBusy() const { return busy; }
+
+    // Block until the queued snapshot, if any, is on disk
+    void wait();
+
+private:
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable changed;
+    std::atomic<bool> busy;
+    bool stopping;
+
+    std::string pendingPath;
+    CheckpointParameters pendingParameters;
+    BodyStore pendingBodies;
+
+    void run();
+};
+
+#endif // CHECKPOINT_H
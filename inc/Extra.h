@@ -6,6 +6,9 @@
 // Forward declarations
 class Body;
 class Simulation;
+class SimulationRunner;
+class BodyRenderer;
+class CheckpointWriter;
 
 class FPS {
 private:
@@ -27,13 +30,15 @@ private:
     sf::Text trailText;
     sf::Text controlsText;
     sf::Text fpsText;
+    sf::Text stepRateText;
     bool hideTui;
     FPS fps;
 
 public:
     UIManager(unsigned int windowWidth, unsigned int windowHeight);
     bool loadFont(const std::string& fontPath);
-    void updateTexts(int numBodies, float dt, float softening, bool showTrails, unsigned int currentFPS);
+    void updateTexts(int numBodies, float dt, float softening, bool showTrails,
+                     unsigned int currentFPS, double stepsPerSecond);
     void draw(sf::RenderWindow& window);
     void toggleUI() { hideTui = !hideTui; }
     bool isUIHidden() const { return hideTui; }
@@ -50,7 +55,7 @@ private:
 public:
     TrailManager(unsigned int windowWidth, unsigned int windowHeight);
     void clear();
-    void update(const std::vector<Body>& bodies);
+    void update(const BodyRenderer& renderer);
     void draw(sf::RenderWindow& window);
     void toggle();
     bool isEnabled() const { return showTrails; }
@@ -71,13 +76,23 @@ private:
     bool isPanning = false;
     sf::Vector2f lastMouseWorldPos;
     sf::Vector2i lastMousePixelPos;
+    CheckpointWriter* checkpointWriter = nullptr;
+    std::string checkpointPath;
 
 public:
     InputHandler(bool& trails, int& bodies, float& timeStep, float& soft, 
                 float gravConst, unsigned int winWidth, unsigned int winHeight);
+
+    // F5 saves to the file through the writer, F9 loads it back
+    void setCheckpoint(CheckpointWriter& writer, const std::string& path) {
+        checkpointWriter = &writer;
+        checkpointPath = path;
+    }
     
     bool handleEvent(const sf::Event& event, sf::RenderWindow& window, 
-                    Simulation& simulation, TrailManager& trailManager,
+                    SimulationRunner& runner, TrailManager& trailManager,
                     UIManager& uiManager, sf::View& view, float& zoomLevel);
 };
 
+// Print the active force solver and its error against the direct sum
+void printForceSolver(const Simulation& simulation);
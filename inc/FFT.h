@@ -0,0 +1,94 @@
+#pragma once
+#ifndef FFT_H
+#define FFT_H
+
+// Small header-only radix-2 FFT for the particle-mesh solver
+
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+class FFT2D {
+public:
+    using Complex = std::complex<float>;
+
+private:
+    size_t n = 0;
+    std::vector<Complex> twiddles;   // exp(-2 pi i k / n) for k < n / 2
+    std::vector<uint32_t> bitReverse;
+
+    void transform(Complex* data, bool inverse) const {
+        for (size_t i = 0; i < n; i++) {
+            size_t j = bitReverse[i];
+            if (i < j) std::swap(data[i], data[j]);
+        }
+
+        for (size_t len = 2; len <= n; len <<= 1) {
+            const size_t half = len / 2;
+            const size_t step = n / len;
+            for (size_t i = 0; i < n; i += len) {
+                for (size_t k = 0; k < half; k++) {
+                    Complex w = inverse ? std::conj(twiddles[k * step]) : twiddles[k * step];
+                    Complex u = data[i + k];
+                    Complex v = data[i + k + half] * w;
+                    data[i + k] = u + v;
+                    data[i + k + half] = u - v;
+                }
+            }
+        }
+    }
+
+    // Rows then columns of an n x n row-major grid; unnormalized
+    void transform2D(std::vector<Complex>& grid, bool inverse) const {
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(static)
+            for (size_t row = 0; row < n; row++) {
+                transform(&grid[row * n], inverse);
+            }
+
+            std::vector<Complex> column(n);
+            #pragma omp for schedule(static)
+            for (size_t col = 0; col < n; col++) {
+                for (size_t row = 0; row < n; row++) column[row] = grid[row * n + col];
+                transform(column.data(), inverse);
+                for (size_t row = 0; row < n; row++) grid[row * n + col] = column[row];
+            }
+        }
+    }
+
+public:
+    // Prepare for n x n grids; n must be a power of two
+    void init(size_t size) {
+        if (size == n) return;
+        n = size;
+
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < n) bits++;
+
+        bitReverse.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t r = 0;
+            for (unsigned b = 0; b < bits; b++) {
+                if (i & (size_t(1) << b)) r |= 1u << (bits - 1 - b);
+            }
+            bitReverse[i] = r;
+        }
+
+        twiddles.resize(n / 2);
+        for (size_t k = 0; k < n / 2; k++) {
+            double angle = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(n);
+            twiddles[k] = Complex(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+        }
+    }
+
+    size_t size() const { return n; }
+
+    void forward(std::vector<Complex>& grid) const { transform2D(grid, false); }
+
+    // Inverse transform without the 1 / n^2 normalization
+    void inverse(std::vector<Complex>& grid) const { transform2D(grid, true); }
+};
+
+#endif // FFT_H
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef FORCE_KERNEL_H
+#define FORCE_KERNEL_H
+
+#include <cstddef>
+
+// Hand-vectorized direct-sum gravity kernel.
+//
+// Adds to (ax[i], ay[i]) the acceleration that every source j exerts on
+// target i, for targets [0, targetCount) and sources [0, sourceCount):
+//
+//     a_i += G * m_j * (p_j - p_i) / (|p_j - p_i|^2 + eps2)^(3/2)
+//
+// Targets may alias sources; a body acting on itself contributes zero as long
+// as eps2 > 0. The implementation (AVX-512, AVX2, SSE or scalar) is picked
+// once at startup from the CPU's capabilities, and can be forced with the
+// NBODY_KERNEL environment variable (avx512, avx2, sse, scalar).
+void accumulateAccelerations(const float* targetX, const float* targetY, size_t targetCount,
+                             const float* sourceX, const float* sourceY, const float* sourceMass,
+                             size_t sourceCount, float G, float eps2,
+                             float* ax, float* ay);
+
+// Block sizes for the cache-blocked kernel. A block of sources (x, y, mass)
+// is reused by every target of a target block before moving on, so it should
+// fit in L1; a target block (x, y, ax, ay) is revisited for every source block
+// and should fit in L2. Zero means "pick from the cache sizes".
+struct KernelTiles {
+    size_t targetBlock;
+    size_t sourceBlock;
+};
+
+// Block sizes derived from the L1/L2 data cache sizes of this machine
+KernelTiles defaultKernelTiles();
+
+// Replace zero entries with the defaults
+KernelTiles resolveKernelTiles(KernelTiles tiles);
+
+// Same result as accumulateAccelerations, computed block by block
+void accumulateAccelerationsBlocked(const float* targetX, const float* targetY, size_t targetCount,
+                                    const float* sourceX, const float* sourceY, const float* sourceMass,
+                                    size_t sourceCount, float G, float eps2,
+                                    float* ax, float* ay, const KernelTiles& tiles);
+
+// Relative error of approximate accelerations against the direct sum
+struct ForceError {
+    float rmsRelative;
+    float maxRelative;
+    int samples;
+};
+
+// Compare (ax, ay) with a double precision direct sum on an evenly spaced
+// sample of bodies
+ForceError compareWithDirectSum(const float* x, const float* y, const float* mass, size_t n,
+                                const float* ax, const float* ay, float G, float eps2, int samples);
+
+// Name of the implementation selected by the dispatcher
+const char* forceKernelName();
+
+// Number of interactions each implementation computes per inner iteration
+int forceKernelWidth();
+
+#endif // FORCE_KERNEL_H
@@ -0,0 +1,116 @@
+#pragma once
+#ifndef FORCE_SOLVER_H
+#define FORCE_SOLVER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BodyStore.h"
+#include "BarnesHut.h"
+#include "ParticleMesh.h"
+#include "ForceKernel.h"
+
+// How the gravitational forces are evaluated each step
+enum class ForceMethod {
+    Direct,       // Exact O(n^2) pair loop
+    BarnesHut,    // O(n log n) quadtree approximation
+    ParticleMesh  // O(n + G^2 log G) FFT mesh, optionally with P3M correction
+};
+
+inline const char* forceMethodName(ForceMethod method) {
+    switch (method) {
+        case ForceMethod::Direct: return "direct";
+        case ForceMethod::BarnesHut: return "barnes-hut";
+        case ForceMethod::ParticleMesh: return "particle-mesh";
+    }
+    return "unknown";
+}
+
+// How the parallel direct sum splits the pair interactions
+enum class DirectSumMode {
+    Symmetric,  // Each pair once (Newton's third law), per-thread buffers reduced afterwards
+    FullRow     // Each body sums its whole row, no reduction needed
+};
+
+// Work on the bodies [begin, end)
+using BodyRangeFn = std::function<void(size_t, size_t)>;
+
+// Everything one force evaluation needs from the simulation. The tree and the
+// mesh belong to the simulation, so switching backends keeps their buffers.
+struct ForceRequest {
+    BodyStore& bodies;
+    float gravitationalConstant;
+    float softening;
+    ForceMethod method;
+    float theta;
+    QuadTree& tree;
+    ParticleMesh& mesh;
+    KernelTiles kernelTiles;
+    DirectSumMode directMode;
+};
+
+// A way of running the force evaluation and the body loops around it: the
+// serial loops, an OpenMP team or the work-stealing pool. The simulation
+// delegates to one of them and may switch at any time; the bodies stay put.
+class ForceSolver {
+public:
+    virtual ~ForceSolver() = default;
+
+    // Name for --backend, and the implementation label for results files
+    virtual const char* name() const = 0;
+    virtual const char* label() const = 0;
+
+    // Threads the backend runs on
+    virtual int threadCount() const = 0;
+    virtual void setThreadCount(int threads) = 0;
+
+    // Overwrite ax/ay with the accelerations at the current positions. If
+    // given, then(begin, end) runs on each range of bodies as soon as its
+    // accelerations are final, in the same parallel pass; it may update
+    // velocities but not positions, which other ranges may still be reading.
+    virtual void computeAccelerations(const ForceRequest& request, const BodyRangeFn& then) = 0;
+
+    // Run body(begin, end) over [0, n) on the backend's threads. Grain 0 is
+    // for loops where every element costs the same: one static slice per
+    // OpenMP thread, matching the first-touch split of the body arrays, or
+    // the pool's own chunking. Otherwise ranges of about grain elements are
+    // handed out on demand, for loops of uneven cost.
+    virtual void forEachRange(size_t n, const BodyRangeFn& body, size_t grain = 0) = 0;
+
+    // Call fn(thread) exactly once on every thread of the backend
+    virtual void forEachThread(const std::function<void(int)>& fn) = 0;
+};
+
+using ForceSolverFactory = std::unique_ptr<ForceSolver> (*)();
+
+// Backends register themselves at startup; returns true so it can initialize a static
+bool registerForceSolver(const char* name, ForceSolverFactory factory);
+
+// Registered name of a backend, with "omp" accepted for "openmp"; empty if unknown
+std::string resolveForceSolverName(const std::string& name);
+
+// New instance of the named backend, null if there is none
+std::unique_ptr<ForceSolver> createForceSolver(const std::string& name);
+
+// Registered backend names in alphabetical order
+std::vector<std::string> forceSolverNames();
+
+// Backend used when none is asked for
+const char* defaultForceSolver();
+
+// Backend implied by a program name ending in _serial, _omp or _pool, the
+// names the per-backend binaries used to have; the default otherwise
+std::string forceSolverForProgram(const std::string& programName);
+
+// Direct sum on the calling thread: full rows through the vectorized,
+// cache-blocked kernel. With one thread it beats the symmetric pair loop,
+// whose j side does not vectorize as well and needs a reduction pass.
+void directAccelerations(const ForceRequest& request);
+
+// Particle-mesh accelerations with the mesh's own OpenMP loops limited to
+// the given number of threads
+void meshAccelerations(const ForceRequest& request, int threads);
+
+#endif // FORCE_SOLVER_H
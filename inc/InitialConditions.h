@@ -0,0 +1,51 @@
+#pragma once
+#ifndef INITIAL_CONDITIONS_H
+#define INITIAL_CONDITIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "BodyStore.h"
+
+class ForceSolver;
+
+// Where the starting bodies come from
+enum class Distribution {
+    Disk,      // Central mass with bodies on near-circular orbits, a few heavy ones
+    Plummer,   // Plummer sphere seen from above, velocities from its distribution function
+    Uniform,   // Cold bodies spread evenly over the world
+    Galaxies   // Two rotating disks on a grazing collision course
+};
+
+const char* distributionName(Distribution distribution);
+
+// Parse "disk", "plummer", "uniform" or "galaxies"; returns false if unknown
+bool parseDistribution(const std::string& name, Distribution& distribution);
+
+struct InitialConditions {
+    Distribution distribution = Distribution::Disk;
+    uint64_t seed = 1;            // Same seed, same bodies, on any number of threads
+    float maxMassSmall = 100.0f;
+    float maxMassBig = 8000.0f;   // Disk: the heavy bodies
+};
+
+// Bodies generateBodies() creates when asked for n; the disk adds one heavy
+// body per 50
+std::size_t generatedBodyCount(const InitialConditions& conditions, int n);
+
+// Replace the store's contents with generated bodies in a world of the given
+// size. Every body draws from its own counter-based random stream keyed by
+// the seed and its index, so the bodies are generated in parallel on the
+// solver's threads, each writing, and first touching, its own range of the
+// preallocated arrays.
+void generateBodies(const InitialConditions& conditions, int n, float gravitationalConstant,
+                    float width, float height, BodyStore& bodies, ForceSolver& solver);
+
+// Fill the batch with count more bodies of the distribution generateBodies()
+// made for n, drawn from the streams of the ids they will get from firstId
+// on. The same additions after the same start give the same bodies; the
+// distribution is the initial one, wherever the system has moved since.
+void generateMoreBodies(const InitialConditions& conditions, int n, int count, float gravitationalConstant,
+                        float width, float height, BodyStore& batch, uint32_t firstId);
+
+#endif // INITIAL_CONDITIONS_H
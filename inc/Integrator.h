@@ -0,0 +1,32 @@
+#pragma once
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include <string>
+
+// Time integration scheme used by Simulation::update()
+enum class Integrator {
+    Euler,           // Semi-implicit Euler, 1 force evaluation per step
+    Leapfrog,        // Kick-drift-kick leapfrog, 1 force evaluation per step
+    VelocityVerlet,  // Velocity Verlet, 1 force evaluation per step
+    Yoshida4,        // 4th order Yoshida (three leapfrog substeps), 3 per step
+    BlockLeapfrog    // KDK leapfrog with per-body power-of-two steps
+};
+
+// Hierarchical block time steps: a body on level L advances by dt / 2^L and
+// only bodies finishing their own step get new forces on a substep
+struct BlockStepSettings {
+    int maxLevel = 6;         // Deepest level, the smallest step is dt / 2^maxLevel
+    float accuracy = 0.05f;   // eta in dt_i = eta * sqrt(softening / |a_i|)
+};
+
+const char* integratorName(Integrator integrator);
+
+// Parse "euler", "leapfrog", "verlet", "yoshida4" or "block"; returns false if unknown
+bool parseIntegrator(const std::string& name, Integrator& integrator);
+
+// Full force evaluations one step of the scheme costs; for block steps only the
+// final substep is a full one, the others cover just the active bodies
+int forceEvaluationsPerStep(Integrator integrator);
+
+#endif // INTEGRATOR_H
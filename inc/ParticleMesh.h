@@ -0,0 +1,86 @@
+#pragma once
+#ifndef PARTICLE_MESH_H
+#define PARTICLE_MESH_H
+
+#include <complex>
+#include <vector>
+#include "FFT.h"
+#include "ForceKernel.h"
+
+struct BodyStore;
+
+// How particle masses are spread onto the mesh and forces read back
+enum class MassAssignment {
+    CIC,  // Cloud-in-cell, 2x2 nodes
+    TSC   // Triangular-shaped cloud, 3x3 nodes
+};
+
+// Particle-mesh gravity: masses are deposited onto a grid, convolved with the
+// force kernel through a zero-padded FFT (isolated boundaries) and the field
+// is interpolated back to the particles. Cost is O(n + G^2 log G).
+//
+// The bodies feel 1/r^2 gravity confined to a plane, so instead of solving the
+// 2D Poisson equation (whose force falls off as 1/r) the mesh convolves with
+// the softened 1/r^2 kernel itself, which matches the direct sum.
+//
+// With the short-range correction enabled (P3M) the mesh only carries the
+// smooth long-range part of the force and pairs closer than a few cells are
+// summed directly, recovering full resolution at small separations.
+class ParticleMesh {
+public:
+    struct Settings {
+        int gridSize = 256;                        // Cells per side, a power of two
+        MassAssignment assignment = MassAssignment::CIC;
+        bool shortRange = false;                   // Add the P3M direct correction
+    };
+
+private:
+    using Complex = FFT2D::Complex;
+
+    Settings settings;
+
+    // Square domain covered by the mesh, refitted when bodies leave it
+    float originX = 0.0f, originY = 0.0f;
+    float cellSize = 0.0f;
+    int grid = 0;
+    bool domainValid = false;
+
+    // Transformed kernel (x + i y components) and the parameters it was built for
+    std::vector<Complex> kernelHat;
+    float kernelCellSize = 0.0f, kernelSoftening = -1.0f, kernelG = 0.0f;
+    bool kernelShortRange = false;
+
+    std::vector<Complex> work;           // Padded 2G x 2G mass, then field
+    FFT2D fft;
+
+    // Bodies bucketed by the first mesh row of their stencil, for the deposit
+    std::vector<int> bodyRow, rowStart, rowBodies;
+
+    // Chaining mesh for the short-range pairs
+    std::vector<int> cellStart, cellBodies;
+    int chainCells = 0;
+    float chainSize = 0.0f;
+
+    float splitScale() const { return 1.25f * cellSize; }
+    float cutoffRadius() const { return 5.0f * splitScale(); }
+
+    void fitDomain(const BodyStore& bodies);
+    void buildKernel(float G, float softening);
+    void deposit(const BodyStore& bodies);
+    void interpolate(const BodyStore& bodies, float* ax, float* ay) const;
+    void addShortRange(const BodyStore& bodies, float G, float softening, float* ax, float* ay);
+
+public:
+    void setSettings(const Settings& s);
+    const Settings& getSettings() const { return settings; }
+
+    // Overwrite (ax, ay) with the accelerations of all bodies
+    void computeAccelerations(const BodyStore& bodies, float G, float softening,
+                              float* ax, float* ay);
+};
+
+// Compare particle-mesh accelerations against the direct sum on a sample of bodies
+ForceError measureParticleMeshError(const BodyStore& bodies, const ParticleMesh::Settings& settings,
+                                    float G, float softening, int samples);
+
+#endif // PARTICLE_MESH_H
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+
+// Scoped-timer instrumentation. PROFILE_SCOPE("name") records the time until
+// the end of the enclosing block into a per-thread log; while the profiler is
+// disabled that costs one relaxed atomic load. Logs can be exported as a
+// Chrome trace (chrome://tracing, ui.perfetto.dev) and summarized per phase.
+// Defining NBODY_NO_PROFILER compiles all scopes away.
+class Profiler {
+private:
+    static std::atomic<bool> enabled;
+
+public:
+    static void enable(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // Nanoseconds on the steady clock
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Append a finished interval to the calling thread's log
+    static void record(const char* name, uint64_t start, uint64_t end);
+
+    // Label the calling thread in the trace; unnamed threads (OpenMP workers)
+    // are numbered in order of their first event
+    static void setThreadName(const std::string& name);
+
+    // Export and summarize; call once the instrumented threads are idle
+    static bool writeChromeTrace(const std::string& path);
+
+    // Count, total and p50/p95/p99/max duration of every phase
+    static void printSummary(std::ostream& out);
+
+    // Number of intervals and their summed duration, over all threads
+    struct PhaseTotal {
+        uint64_t count = 0;
+        uint64_t nanoseconds = 0;
+    };
+    static std::map<std::string, PhaseTotal> phaseTotals();
+
+    // Drop every recorded interval; thread names are kept
+    static void clear();
+};
+
+class ScopedTimer {
+private:
+    const char* name;
+    uint64_t start;
+
+public:
+    explicit ScopedTimer(const char* phase)
+        : name(Profiler::isEnabled() ? phase : nullptr), start(name ? Profiler::now() : 0) {}
+    ~ScopedTimer() {
+        if (name) Profiler::record(name, start, Profiler::now());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef NBODY_NO_PROFILER
+#define PROFILE_SCOPE(name) ((void)0)
+#else
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
+
+#endif // PROFILER_H
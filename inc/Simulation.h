@@ -3,31 +3,238 @@
 #define SIMULATION_H
 
 #include <vector>
+#include <cstdint>
+#include <memory>
+#include <string>
 #include "Body.h"
-#include <omp.h>
+#include "BodyStore.h"
 #include "Extra.h"
+#include "BarnesHut.h"
+#include "ParticleMesh.h"
+#include "ForceKernel.h"
+#include "ForceSolver.h"
+#include "Integrator.h"
+#include "SpatialOrder.h"
+#include "Affinity.h"
+#include "Checkpoint.h"
+#include "Trajectory.h"
+#include "InitialConditions.h"
 
 class Simulation {
 private:
-    std::vector<Body> bodies;
+    BodyStore bodies;
     float gravitationalConstant;
     float softening; // To prevent division by zero in force calculation
     float timeStep;
     float width;
     float height;
+    ForceMethod forceMethod;
+    float theta; // Barnes-Hut opening angle, smaller is more accurate
+    QuadTree tree;
+    ParticleMesh mesh;
+
+    // Time integration
+    Integrator integrator;
+    bool accelerationsValid;                   // ax/ay belong to the current positions
+    AlignedVector<float> previousAx, previousAy;  // Velocity Verlet's a(t)
+
+    // Time the velocities trail the positions by between steps: half a step
+    // after Euler, none after the kick-drift-kick schemes. Negative until the
+    // first step, which takes the velocities as they are.
+    float velocityLag;
+    void resynchronizeVelocities(float lag);
+
+    // Block time steps
+    BlockStepSettings blockSteps;
+    std::vector<uint8_t> stepLevel;            // Level of every body, kept for the next base step
+    std::vector<float> idealStep;              // Step each body's criteria ask for
+    std::vector<uint32_t> fineBodies;          // Bodies below the base step, by partner cell
+    std::vector<uint32_t> fineCellStart;       // Offsets into fineBodies per partner cell
+    std::vector<uint32_t> activeBodies;        // Bodies finishing their step on this substep
+    AlignedVector<float> activeX, activeY, activeAx, activeAy;
+    std::vector<size_t> levelCounts;
+
+    // Work counters: steps taken and single-body force evaluations
+    uint64_t stepCount;
+    uint64_t forceEvaluations;
+
+    // Space-filling-curve sorting of the bodies, with its cost so far
+    ReorderSettings reorder;
+    std::vector<uint32_t> reorderOrder;
+    uint64_t reorderCount;
+    double reorderSeconds;
+
+    // NUMA placement: thread pinning and which thread first touches the arrays
+    AffinityMode affinity;
+    int pinnedThreads;                         // Team size last pinned, 0 if not pinned
+    std::vector<ThreadPlacement> placement;
+    bool bodiesPlaced;                         // Hot arrays first touched by the static split
+
+    // Force backends created so far, kept so switching back reuses their
+    // threads and buffers, and the one in use
+    std::vector<std::unique_ptr<ForceSolver>> solvers;
+    ForceSolver* solver;
+
+    // How the current bodies were generated, and how many were asked for
+    InitialConditions initialConditions;
+    int initialBodyCount;
+
+    // Array index of every id handed out, NO_BODY once removed; rebuilt on
+    // the first removal after the bodies were reordered or replaced
+    static constexpr uint32_t NO_BODY = UINT32_MAX;
+    std::vector<uint32_t> indexOfId;
+    bool indexOfIdValid;
+    BodyStore insertBatch;                     // Reused by addBodies
+    void buildIndexOfId();
+    void removeAt(size_t i);
+
+    // Trajectory output every few steps, not owned
+    TrajectoryWriter* trajectory;
+    void recordTrajectory();
+
+    // Overwrite ax/ay through the backend, see ForceSolver::computeAccelerations
+    void computeAccelerations(const BodyRangeFn& then);
+    void kick(float dt, size_t begin, size_t end);
+    void kickDrift(float kickDt, float driftDt);
+    void evaluateAllForces(const BodyRangeFn& then = nullptr);
+    void leapfrogStep(float dt);
+    int assignStepLevels(float dt);
+    void computeActiveAccelerations();
+    void blockStep(float dt);
+    void placeBodies();
+
+    // Cache block sizes for the direct-sum kernel, zero for automatic
+    KernelTiles kernelTiles;
+    DirectSumMode directMode;
 
 public:
     // Constructor
     Simulation(float g, float soften, float dt, float w, float h);
 
-    // Initialize with random bodies
-    void initializeRandomBodies(int n, float maxMassSmall, float MaxMassBig);
+    // Replace the bodies with n generated from the conditions, see
+    // generateBodies(); the same seed always gives the same bodies
+    void initializeBodies(int n, const InitialConditions& conditions = InitialConditions());
+    const InitialConditions& getInitialConditions() const { return initialConditions; }
 
-    // Calculate forces between all bodies and update their positions
+    // Insert and remove batches of bodies in the running simulation, both
+    // amortized O(batch): the arrays grow geometrically and keep their room
+    // when shrinking, and a removal moves the last body into the gap. The
+    // tree, the mesh and the tiling follow on the next evaluation, which
+    // also recomputes the accelerations.
+    //
+    // insertBodies() gives the batch's bodies new ids; addBodies() draws
+    // count more from the initial distribution, the same ones for the same
+    // seed. removeBodies() skips ids that are not there and returns how many
+    // were removed; removeNewestBodies() takes the highest ids first.
+    void insertBodies(const BodyStore& batch);
+    void addBodies(int count);
+    size_t removeBodies(const std::vector<uint32_t>& ids);
+    size_t removeNewestBodies(size_t count);
+
+    // Advance all bodies by one time step with the selected integrator
     void update();
 
-    // Getter for bodies vector
-    const std::vector<Body>& getBodies() const;
+    // Read-only view of the bodies
+    BodyView getBodies() const;
+
+    // Direct access to the body arrays
+    const BodyStore& getStore() const { return bodies; }
+
+    // Switch the force backend by name (see forceSolverNames()); the bodies
+    // and their accelerations carry over. False if there is no such backend.
+    bool setBackend(const std::string& name);
+    const ForceSolver& getBackend() const { return *solver; }
+
+    // Threads the backend computes forces with
+    int getThreadCount() const { return solver->threadCount(); }
+    void setThreadCount(int threads);
+
+    // Change dt and softening on the running system, from the next step on.
+    // Not synchronized: call between steps, from the render thread through
+    // SimulationRunner::post. A new softening recomputes the accelerations;
+    // a new dt under Euler shifts the velocities to its half-step lag.
+    void setTimeStep(float dt) { timeStep = dt; }
+    float getTimeStep() const { return timeStep; }
+    void setSoftening(float soften) {
+        if (soften != softening) accelerationsValid = false;
+        softening = soften;
+    }
+    float getSoftening() const { return softening; }
+
+    // Force solver selection
+    void setForceMethod(ForceMethod method) { forceMethod = method; accelerationsValid = false; }
+    ForceMethod getForceMethod() const { return forceMethod; }
+    void setTheta(float t) { theta = t; accelerationsValid = false; }
+    float getTheta() const { return theta; }
+    void setDirectSumMode(DirectSumMode mode) { directMode = mode; }
+    DirectSumMode getDirectSumMode() const { return directMode; }
+    void setKernelTiles(KernelTiles tiles) { kernelTiles = tiles; }
+    KernelTiles getKernelTiles() const { return resolveKernelTiles(kernelTiles); }
+
+    void setMeshSettings(const ParticleMesh::Settings& settings) {
+        mesh.setSettings(settings);
+        accelerationsValid = false;
+    }
+    const ParticleMesh::Settings& getMeshSettings() const { return mesh.getSettings(); }
+
+    // Integrator selection; the next step recomputes accelerations and, on a
+    // switch to or from Euler, resynchronizes the velocities
+    void setIntegrator(Integrator i) { integrator = i; accelerationsValid = false; }
+    Integrator getIntegrator() const { return integrator; }
+
+    void setBlockStepSettings(const BlockStepSettings& settings) { blockSteps = settings; }
+    const BlockStepSettings& getBlockStepSettings() const { return blockSteps; }
+
+    // Bodies per level in the last block step, index 0 is the base level
+    const std::vector<size_t>& getLevelCounts() const { return levelCounts; }
+    uint64_t getStepCount() const { return stepCount; }
+    uint64_t getForceEvaluations() const { return forceEvaluations; }
+
+    // Sort the bodies along a space-filling curve every few steps so that
+    // neighbours in space share cache lines; ids keep the identities
+    void setReorderSettings(const ReorderSettings& settings) { reorder = settings; }
+    const ReorderSettings& getReorderSettings() const { return reorder; }
+
+    // Sort now along the configured curve; does nothing for None
+    void reorderBodies();
+    uint64_t getReorderCount() const { return reorderCount; }
+    double getReorderSeconds() const { return reorderSeconds; }
+
+    // Pin the force threads on the next step; the mapping used is printed
+    // and kept for getThreadPlacement()
+    void setAffinity(AffinityMode mode) { affinity = mode; pinnedThreads = 0; }
+    AffinityMode getAffinity() const { return affinity; }
+    const std::vector<ThreadPlacement>& getThreadPlacement() const { return placement; }
+
+    // Where the backend's threads run right now, pinned or not
+    std::vector<ThreadPlacement> measureThreadPlacement() { return currentPlacement(*solver); }
+
+    // Hand the parameters and a copy of the bodies to the writer's thread;
+    // false if it is still writing the previous checkpoint
+    bool saveCheckpoint(CheckpointWriter& writer, const std::string& path) const;
+
+    // Replace the bodies and parameters with those of a checkpoint, copied
+    // from the mapped file straight into the arrays. The backend, affinity
+    // and thread count stay. On failure nothing changes and error says why.
+    bool loadCheckpoint(const std::string& path, std::string& error);
+
+    // Hand positions and velocities to the writer every interval steps of
+    // its settings, null to stop. Only the copy into its ring runs on the
+    // step loop; encoding and writing happen on the writer's thread.
+    void setTrajectoryWriter(TrajectoryWriter* writer) { trajectory = writer; }
+    TrajectoryWriter* getTrajectoryWriter() const { return trajectory; }
+
+    // Kinetic plus softened potential energy, O(n^2)
+    double totalEnergy() const;
+
+    // Error of the approximate solver's forces against the direct sum on a sample of bodies
+    ForceError measureForceError(int samples = 64) const {
+        if (forceMethod == ForceMethod::ParticleMesh) {
+            return measureParticleMeshError(bodies, mesh.getSettings(), gravitationalConstant,
+                                            softening, samples);
+        }
+        return measureBarnesHutError(bodies, theta, gravitationalConstant, softening, samples);
+    }
 };
 
 #endif // SIMULATION_H
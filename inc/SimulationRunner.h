@@ -0,0 +1,78 @@
+#pragma once
+#ifndef SIMULATION_RUNNER_H
+#define SIMULATION_RUNNER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include "TripleBuffer.h"
+
+class Simulation;
+
+// Immutable copy of what the renderer needs from one completed step
+struct BodySnapshot {
+    std::vector<float> x, y;
+    std::vector<float> radius;
+    std::vector<sf::Color> color;
+    uint64_t step = 0;
+
+    std::size_t size() const { return x.size(); }
+};
+
+// Steps the simulation on its own thread and publishes a snapshot after every
+// step. The render loop draws the latest snapshot and sends changes as
+// commands, which run on the simulation thread between two steps.
+class SimulationRunner {
+public:
+    using Command = std::function<void(Simulation&)>;
+    using StepObserver = std::function<void(double seconds)>;
+
+private:
+    Simulation& simulation;
+    std::thread thread;
+    std::atomic<bool> running;
+
+    std::mutex commandMutex;
+    std::vector<Command> commands;        // Posted by the render thread
+    std::vector<Command> executing;       // Swapped out by the simulation thread
+
+    TripleBuffer<BodySnapshot> snapshots;
+
+    StepObserver stepObserver;            // Called on the simulation thread
+    float stepRateLimit;                  // Steps per second, 0 for unlimited
+    std::atomic<double> stepsPerSecond;
+    std::atomic<uint64_t> stepsTaken;
+
+    void run();
+    void runCommands();
+    void publish();
+
+public:
+    explicit SimulationRunner(Simulation& sim, float maxStepsPerSecond = 0.0f);
+    ~SimulationRunner();
+
+    SimulationRunner(const SimulationRunner&) = delete;
+    SimulationRunner& operator=(const SimulationRunner&) = delete;
+
+    void start();
+    void stop();
+
+    // Receive the wall time of every step; set before start()
+    void setStepObserver(StepObserver observer) { stepObserver = std::move(observer); }
+
+    // Queue a change to the simulation; applied before the next step
+    void post(Command command);
+
+    // Switch to the newest snapshot if one was published; false if unchanged
+    bool acquire() { return snapshots.update(); }
+    const BodySnapshot& latest() const { return snapshots.readBuffer(); }
+
+    double getStepsPerSecond() const { return stepsPerSecond.load(std::memory_order_relaxed); }
+    uint64_t getStepsTaken() const { return stepsTaken.load(std::memory_order_relaxed); }
+};
+
+#endif // SIMULATION_RUNNER_H
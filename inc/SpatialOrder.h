@@ -0,0 +1,40 @@
+#pragma once
+#ifndef SPATIAL_ORDER_H
+#define SPATIAL_ORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Space-filling curves for sorting bodies so that neighbours in space are
+// neighbours in memory. Hilbert order keeps every run of the curve compact;
+// Morton order is cheaper to compute but jumps across quadrant borders.
+enum class SpaceFillingCurve {
+    None,
+    Morton,
+    Hilbert
+};
+
+const char* curveName(SpaceFillingCurve curve);
+
+// Parse "none", "morton"/"z" or "hilbert"; false if unknown
+bool parseCurve(const std::string& name, SpaceFillingCurve& curve);
+
+// How often the simulation re-sorts its bodies; bodies drift out of order
+// slowly, so a sort every few dozen steps keeps most of the locality
+struct ReorderSettings {
+    SpaceFillingCurve curve = SpaceFillingCurve::Hilbert;
+    int interval = 32;  // Steps between sorts, 0 to disable
+};
+
+// Position of a cell on the curve, for cell coordinates below 2^16
+uint32_t mortonKey(uint32_t x, uint32_t y);
+uint32_t hilbertKey(uint32_t x, uint32_t y);
+
+// Body indices sorted by the curve key of their position over the bounding
+// box of all bodies; order[k] is the body that goes to slot k
+void spatialOrder(const float* x, const float* y, size_t n, SpaceFillingCurve curve,
+                  std::vector<uint32_t>& order);
+
+#endif // SPATIAL_ORDER_H
@@ -0,0 +1,101 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent worker threads for the pool backend. A parallel loop is cut into
+// chunks; every worker starts on its own contiguous share and, once that runs
+// out, steals the back half of what another worker has left. The calling
+// thread takes part as worker 0, and idle workers spin briefly before they
+// sleep, so the loops of one step do not each pay a fork/join.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool size to start with: NBODY_THREADS or the hardware thread count
+    static int defaultSize();
+
+    int size() const { return threadCount; }
+
+    // Replace the workers by the given number; not from inside a loop
+    void resize(int threads);
+
+    // Index of the calling worker in [0, size()), 0 outside the pool
+    static int currentWorker();
+
+    // Call body(begin, end) on chunks of [0, n), each at least grain long
+    // (automatic for 0), and return once all of them are done. Loops are
+    // started from one thread at a time.
+    template <typename F>
+    void parallelFor(size_t n, F&& body, size_t grain = 0) {
+        using Body = typename std::remove_reference<F>::type;
+        run(n, grain, [](void* context, size_t begin, size_t end) {
+            (*static_cast<Body*>(context))(begin, end);
+        }, const_cast<void*>(static_cast<const void*>(&body)));
+    }
+
+    // Call fn(worker) exactly once on every worker, each on its own thread
+    void forEachWorker(const std::function<void(int)>& fn);
+
+    // Loops run and chunks taken from another worker since construction
+    uint64_t getLoopCount() const { return loopCount; }
+    uint64_t getStealCount() const;
+
+private:
+    using ChunkFn = void (*)(void*, size_t, size_t);
+
+    // Chunk range still owned by a worker: next chunk in the low half, end in
+    // the high half, so the owner and thieves update both with one CAS
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> range{0};
+        uint64_t steals = 0;
+    };
+
+    // The loop being run; written by the caller before the epoch is bumped
+    struct Job {
+        ChunkFn fn = nullptr;
+        void* context = nullptr;
+        size_t n = 0;
+        size_t chunkSize = 0;
+        bool perWorker = false;  // One chunk per worker and no stealing
+    };
+
+    int threadCount;
+    std::unique_ptr<Slot[]> slots;
+    std::vector<std::thread> workers;
+    Job job;
+    uint64_t loopCount;
+
+    std::atomic<uint64_t> epoch;    // Bumped once per loop
+    std::atomic<int> pending;       // Workers (not counting the caller) still in the loop
+    std::atomic<int> sleepers;
+    std::atomic<bool> stopping;
+    std::mutex wakeLock;
+    std::condition_variable wake;
+
+    void start(int threads);
+    void stop();
+    void run(size_t n, size_t grain, ChunkFn fn, void* context);
+    void dispatch();
+    void workerLoop(int worker, uint64_t seen);
+    void work(int worker);
+    bool popOwn(Slot& slot, uint32_t& chunk);
+    bool steal(int worker, uint32_t& chunk);
+    void execute(uint32_t chunk);
+};
+
+#endif // THREAD_POOL_H
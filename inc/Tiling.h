@@ -0,0 +1,39 @@
+#pragma once
+#ifndef TILING_H
+#define TILING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tiles of the triangular i <= j iteration space of the pair loop.
+// Body indices are cut into blocks; tile (I, J) with I <= J covers every pair
+// (i in block I, j in block J, i < j). Tiles are listed row by row together
+// with a running total of their pair counts, so the list can be split into
+// contiguous ranges of equal work for any number of threads.
+class TriangularTiling {
+public:
+    struct Tile {
+        uint32_t iBegin, iEnd;
+        uint32_t jBegin, jEnd;
+    };
+
+private:
+    std::vector<Tile> tiles;
+    std::vector<uint64_t> workPrefix;  // workPrefix[t] = pairs in tiles [0, t)
+    size_t bodyCount = 0;
+    size_t blockSize = 0;
+
+public:
+    // Rebuild the tile list; a no-op if n and the block size are unchanged
+    void build(size_t n, size_t block);
+
+    // Tiles [first, second) holding roughly 1/parts of all pairs
+    std::pair<size_t, size_t> range(size_t part, size_t parts) const;
+
+    const Tile& operator[](size_t t) const { return tiles[t]; }
+    size_t size() const { return tiles.size(); }
+    size_t getBlockSize() const { return blockSize; }
+};
+
+#endif // TILING_H
@@ -0,0 +1,167 @@
+#pragma once
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streaming trajectory output: every k-th step's positions and velocities
+// appended to one file as a sequence of self-describing frames.
+//
+// File layout, all values native-endian:
+//   TrajectoryFileHeader
+//   per frame: TrajectoryFrameHeader, then payloadBytes of data
+// Bodies are written in id order. Payload per encoding:
+//   raw:       id, x, y, vx, vy as n uint32/float each
+//   quantized: id as n uint32, then for x, y, vx, vy a float offset, a float
+//              scale and n uint16, value = offset + scale * q
+//   delta:     fixed-point q = round(value / precision). Keyframes hold the
+//              id gaps and q as varints; other frames hold only the change in
+//              q since the previous frame, zigzag varints. Bodies and their
+//              order are those of the last keyframe.
+
+enum class TrajectoryEncoding {
+    Raw,        // Lossless floats, 20 bytes per body
+    Quantized,  // 16 bits per value over each frame's range
+    Delta       // Fixed-point differences between frames
+};
+
+const char* trajectoryEncodingName(TrajectoryEncoding encoding);
+
+// Parse "raw", "quantized" or "delta"; returns false if unknown
+bool parseTrajectoryEncoding(const std::string& name, TrajectoryEncoding& encoding);
+
+struct TrajectorySettings {
+    int interval = 10;            // Steps between frames
+    TrajectoryEncoding encoding = TrajectoryEncoding::Delta;
+    float precision = 1e-3f;      // Delta: fixed-point step for positions and velocities
+    int keyframeInterval = 32;    // Delta: frames between keyframes
+    int bufferFrames = 8;         // Snapshots the simulation may be ahead of the disk
+};
+
+const uint32_t TRAJECTORY_VERSION = 1;
+
+struct TrajectoryFileHeader {
+    char magic[8];                // "NBODYTRJ"
+    uint32_t version;
+    uint32_t byteOrder;           // 0x01020304 as written
+    uint32_t encoding;            // TrajectoryEncoding
+    uint32_t interval;
+    float precision;
+    uint32_t keyframeInterval;
+};
+
+enum TrajectoryFrameFlags : uint32_t {
+    FrameKeyframe = 1             // Delta: absolute values, starts a new body list
+};
+
+struct TrajectoryFrameHeader {
+    char tag[4];                  // "FRME", to resynchronize after a damaged frame
+    uint32_t flags;
+    uint64_t step;
+    float timeStep;               // dt of the step that ended here
+    uint32_t bodyCount;
+    uint64_t payloadBytes;
+};
+
+// One frame as handed over by the simulation and as decoded by the reader
+struct TrajectoryFrame {
+    uint64_t step = 0;
+    float timeStep = 0.0f;
+    std::vector<uint32_t> id;
+    std::vector<float> x, y, vx, vy;
+
+    std::size_t size() const { return x.size(); }
+    void resize(std::size_t n);
+};
+
+// Appends frames from a background thread. The simulation fills a free slot
+// of a fixed ring and publishes it without waiting; when the writer falls
+// behind and the ring is full, frames are dropped and counted rather than
+// stalling the step loop.
+class TrajectoryWriter {
+public:
+    TrajectoryWriter();
+    ~TrajectoryWriter();
+
+    TrajectoryWriter(const TrajectoryWriter&) = delete;
+    TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+    // Create the file, write its header and start the thread; false with a
+    // message if the file cannot be created
+    bool open(const std::string& path, const TrajectorySettings& settings, std::string& error);
+    bool isOpen() const { return worker.joinable(); }
+
+    // Write everything still queued, close the file and print a summary
+    void close();
+
+    const TrajectorySettings& getSettings() const { return settings; }
+
+    // Producer side, one thread only: fill acquire()'s frame, then publish()
+    // it. Null if the ring is full; the frame then counts as dropped.
+    TrajectoryFrame* acquire();
+    void publish();
+
+    uint64_t getFramesWritten() const { return framesWritten; }
+    uint64_t getFramesDropped() const { return framesDropped; }
+    uint64_t getBytesWritten() const { return bytesWritten; }
+
+private:
+    TrajectorySettings settings;
+    std::string path;
+    std::ofstream file;
+    std::thread worker;
+
+    // Single-producer, single-consumer ring: slots [tail, head) are queued
+    std::vector<TrajectoryFrame> ring;
+    std::atomic<uint64_t> head;   // Advanced by the producer
+    std::atomic<uint64_t> tail;   // Advanced by the writer thread
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    bool stopping;
+
+    std::atomic<uint64_t> framesWritten;
+    std::atomic<uint64_t> framesDropped;
+    std::atomic<uint64_t> bytesWritten;
+    uint64_t rawBytes;            // What the frames would take uncompressed
+
+    // Encoder state, only touched by the writer thread
+    std::vector<uint32_t> order;
+    std::vector<uint8_t> payload;
+    std::vector<uint32_t> keyIds;                 // Bodies of the last keyframe
+    std::vector<int64_t> previous[4];             // Their fixed-point x, y, vx, vy
+    uint64_t framesSinceKeyframe;
+
+    void run();
+    void writeFrame(const TrajectoryFrame& frame);
+    uint32_t encodeRaw(const TrajectoryFrame& frame);
+    uint32_t encodeQuantized(const TrajectoryFrame& frame);
+    uint32_t encodeDelta(const TrajectoryFrame& frame);
+};
+
+// Reads a trajectory file frame by frame, undoing the encoding
+class TrajectoryReader {
+public:
+    bool open(const std::string& path, std::string& error);
+    const TrajectoryFileHeader& header() const { return fileHeader; }
+
+    // Next frame in id order; false at the end of the file or with error set
+    // if the file is damaged
+    bool next(TrajectoryFrame& frame, std::string& error);
+
+private:
+    std::ifstream file;
+    TrajectoryFileHeader fileHeader;
+    std::vector<uint8_t> payload;
+    std::vector<uint32_t> keyIds;
+    std::vector<int64_t> previous[4];
+};
+
+#endif // TRAJECTORY_H
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer, single-consumer triple buffer. The writer fills
+// its back buffer and publishes it; the reader picks up the most recently
+// published buffer. Neither side ever waits for the other, and a buffer is
+// never touched by both at once.
+template <typename T>
+class TripleBuffer {
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH = 0x4;   // Middle buffer not yet seen by the reader
+
+    T buffers[3];
+    std::atomic<uint8_t> middle{2};
+    uint8_t back = 0;    // Owned by the writer
+    uint8_t front = 1;   // Owned by the reader
+
+public:
+    // Writer side: fill writeBuffer(), then publish() it
+    T& writeBuffer() { return buffers[back]; }
+
+    void publish() {
+        uint8_t previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+    }
+
+    // Reader side: switch to the latest published buffer; false if nothing new
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& readBuffer() const { return buffers[front]; }
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -9,6 +9,7 @@ echo "==================================="
 BODY_COUNTS=(1000 1100 1200 1300 1400 1500 1600 1700 1800 1900 2000 2100 2200 2300 2400 2500 2600 2700 2800 2900 3000)
 TEST_DURATION=15  # seconds
 USE_HEADLESS=false  # Set to true if you have headless benchmark compiled
+FRESH=false  # Start a new results file instead of appending
 
 # Parse command line options
 while [[ $# -gt 0 ]]; do
@@ -25,16 +26,22 @@ while [[ $# -gt 0 ]]; do
             IFS=',' read -ra BODY_COUNTS <<< "$2"
             shift 2
             ;;
+        --fresh)
+            FRESH=true
+            shift
+            ;;
         *)
             echo "Unknown option: $1"
-            echo "Usage: $0 [--headless] [--duration SECONDS] [--bodies COUNT1,COUNT2,...]"
+            echo "Usage: $0 [--headless] [--fresh] [--duration SECONDS] [--bodies COUNT1,COUNT2,...]"
             exit 1
             ;;
     esac
 done
 
-# Remove old results file
-rm -f benchmark_results.csv
+# Results are appended; the committed history is only removed on request
+if [ "$FRESH" = true ]; then
+    rm -f benchmark_results.csv
+fi
 
 echo "Test duration: $TEST_DURATION seconds per test"
 echo "Body counts: ${BODY_COUNTS[*]}"
@@ -53,6 +60,11 @@ if [ -f "./bin/nbody_simulation_omp" ]; then
     echo "Found: OpenMP implementation"
 fi
 
+if [ -f "./bin/nbody_simulation_pool" ]; then
+    BINARIES+=("./bin/nbody_simulation_pool")
+    echo "Found: Pool implementation"
+fi
+
 # Check for headless versions
 if [ "$USE_HEADLESS" = true ]; then
     HEADLESS_BINARIES=()
@@ -65,6 +77,11 @@ if [ "$USE_HEADLESS" = true ]; then
         HEADLESS_BINARIES+=("./bin/headless_benchmark_omp")
         echo "Found: Headless OpenMP implementation"
     fi
+
+    if [ -f "./bin/headless_benchmark_pool" ]; then
+        HEADLESS_BINARIES+=("./bin/headless_benchmark_pool")
+        echo "Found: Headless Pool implementation"
+    fi
     
     if [ ${#HEADLESS_BINARIES[@]} -gt 0 ]; then
         BINARIES=("${HEADLESS_BINARIES[@]}")
@@ -165,10 +182,10 @@ if [ -f "benchmark_results.csv" ]; then
     echo "Results saved to benchmark_results.csv:"
     echo ""
     # Display results in a nice table format
-    printf "%-13s | %-6s | %s\n" "Implementation" "Bodies" "Avg FPS"
-    printf "%-13s | %-6s | %s\n" "-------------" "------" "-------"
-    tail -n +2 benchmark_results.csv | while IFS=',' read -r impl bodies fps; do
-        printf "%-13s | %-6s | %.2f\n" "$impl" "$bodies" "$fps"
+    printf "%-13s | %-6s | %-9s | %s\n" "Implementation" "Bodies" "Avg FPS" "p99 ms"
+    printf "%-13s | %-6s | %-9s | %s\n" "-------------" "------" "-------" "------"
+    tail -n +2 benchmark_results.csv | while IFS=',' read -r impl bodies fps frames warmup mean p50 p95 p99 _; do
+        printf "%-13s | %-6s | %-9.2f | %s\n" "$impl" "$bodies" "$fps" "${p99:--}"
     done
     echo ""
     echo "Total runtime: ${total_runtime} seconds"
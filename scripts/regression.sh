@@ -0,0 +1,203 @@
+#!/bin/bash
+
+# Performance-regression gate: runs the headless benchmark matrix, compares the
+# median mean step time of every configuration with the stored baseline and
+# exits non-zero if any configuration got slower than its noise allows.
+#
+# Baseline rows are keyed by PROJECT_VERSION from inc/version.hpp, so a
+# release's numbers stay in the file after the version is bumped, and by the
+# CPU model, since numbers from another machine say nothing about the code.
+
+set -e
+
+BASELINE="bench/regression_baseline.csv"
+BODY_COUNTS=(1000 4000)
+SOLVERS=(direct barnes-hut)
+DURATION=3       # Measured seconds per run
+REPEATS=3        # Runs per configuration; the median is compared
+TOLERANCE=5      # Percent slowdown always accepted
+UPDATE=false
+AGAINST=""
+
+usage() {
+    echo "Usage: $0 [--update] [--against VERSION] [--baseline FILE] [--bodies N1,N2,...]"
+    echo "          [--solvers S1,S2,...] [--duration SECONDS] [--repeats N] [--tolerance PERCENT]"
+    echo "  --update     Store this run as the baseline of the current version"
+    echo "  --against    Baseline version to compare with (default: current version if stored,"
+    echo "               otherwise the last version in the baseline file)"
+}
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        --update) UPDATE=true; shift ;;
+        --against) AGAINST="$2"; shift 2 ;;
+        --baseline) BASELINE="$2"; shift 2 ;;
+        --bodies) IFS=',' read -ra BODY_COUNTS <<< "$2"; shift 2 ;;
+        --solvers) IFS=',' read -ra SOLVERS <<< "$2"; shift 2 ;;
+        --duration) DURATION="$2"; shift 2 ;;
+        --repeats) REPEATS="$2"; shift 2 ;;
+        --tolerance) TOLERANCE="$2"; shift 2 ;;
+        -h|--help) usage; exit 0 ;;
+        *) echo "Unknown option: $1"; usage; exit 2 ;;
+    esac
+done
+
+VERSION=$(sed -n 's/^#define PROJECT_VERSION "\(.*\)"/\1/p' inc/version.hpp)
+if [ -z "$VERSION" ]; then
+    echo "Error: Could not read PROJECT_VERSION from inc/version.hpp"
+    exit 2
+fi
+
+BINARIES=()
+for binary in ./bin/headless_benchmark_serial ./bin/headless_benchmark_omp ./bin/headless_benchmark_pool; do
+    [ -x "$binary" ] && BINARIES+=("$binary")
+done
+if [ ${#BINARIES[@]} -eq 0 ]; then
+    echo "Error: No headless benchmarks found. Run 'make headless' first."
+    exit 2
+fi
+
+# CSV helpers for awk: the CPU field is quoted and may hold commas
+CSV_AWK='
+function parseCsv(line, fields,    n, i, c, field, quoted) {
+    n = 0; field = ""; quoted = 0
+    for (i = 1; i <= length(line); i++) {
+        c = substr(line, i, 1)
+        if (quoted) {
+            if (c == "\"" && substr(line, i + 1, 1) == "\"") { field = field c; i++ }
+            else if (c == "\"") quoted = 0
+            else field = field c
+        } else if (c == "\"") quoted = 1
+        else if (c == ",") { fields[++n] = field; field = "" }
+        else field = field c
+    }
+    fields[++n] = field
+    return n
+}
+function csvField(text) {
+    gsub(/"/, "\"\"", text)
+    return "\"" text "\""
+}
+'
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+RUNS="$WORK_DIR/runs.csv"
+CURRENT="$WORK_DIR/current.csv"
+
+echo "Regression run for version $VERSION: ${#BINARIES[@]} binaries x ${#BODY_COUNTS[@]} sizes x ${#SOLVERS[@]} solvers, $REPEATS x ${DURATION}s each"
+for binary in "${BINARIES[@]}"; do
+    for bodies in "${BODY_COUNTS[@]}"; do
+        for solver in "${SOLVERS[@]}"; do
+            for ((r = 1; r <= REPEATS; r++)); do
+                printf "  %-26s %6s bodies  %-11s run %d/%d\n" "$(basename "$binary")" "$bodies" "$solver" "$r" "$REPEATS"
+                if ! "$binary" --solver="$solver" --results="$RUNS" "$bodies" "$DURATION" > "$WORK_DIR/log.txt" 2>&1; then
+                    cat "$WORK_DIR/log.txt"
+                    echo "Error: $(basename "$binary") failed"
+                    exit 2
+                fi
+            done
+        done
+    done
+done
+
+# One row per configuration: median mean step time and the relative spread
+# (max - min) / median of the repeats. The mean is exact, where the p50 is a
+# histogram bucket a few percent wide.
+tail -n +2 "$RUNS" | awk -v version="$VERSION" "$CSV_AWK"'
+    {
+        parseCsv($0, f)
+        key = f[1] "," f[2] "," f[14] "," f[15] "," csvField(f[16])
+        if (!(key in count)) order[++keys] = key
+        samples[key, ++count[key]] = f[6]
+    }
+    END {
+        print "Version,Implementation,NumBodies,Solver,Integrator,CPU,MeanMs,Spread"
+        for (k = 1; k <= keys; k++) {
+            key = order[k]; n = count[key]
+            for (i = 1; i <= n; i++) v[i] = samples[key, i]
+            for (i = 2; i <= n; i++) for (j = i; j > 1 && v[j - 1] > v[j]; j--) { t = v[j]; v[j] = v[j - 1]; v[j - 1] = t }
+            median = (n % 2) ? v[(n + 1) / 2] : (v[n / 2] + v[n / 2 + 1]) / 2
+            spread = median > 0 ? (v[n] - v[1]) / median : 0
+            printf "%s,%s,%.4f,%.4f\n", version, key, median, spread
+        }
+    }' > "$CURRENT"
+
+CPU=$(awk "$CSV_AWK"'NR == 2 { parseCsv($0, f); print f[6] }' "$CURRENT")
+export CPU
+
+if [ "$UPDATE" = true ]; then
+    # Replace this version's rows for this CPU, keep every other version and CPU
+    if [ -f "$BASELINE" ]; then
+        awk -v version="$VERSION" "$CSV_AWK"'
+            NR == 1 { print; next }
+            { parseCsv($0, f) }
+            f[1] != version || f[6] != ENVIRON["CPU"]' "$BASELINE" > "$WORK_DIR/baseline.csv"
+    else
+        head -n 1 "$CURRENT" > "$WORK_DIR/baseline.csv"
+    fi
+    tail -n +2 "$CURRENT" >> "$WORK_DIR/baseline.csv"
+    mv "$WORK_DIR/baseline.csv" "$BASELINE"
+    echo ""
+    echo "Stored $(($(wc -l < "$CURRENT") - 1)) configurations as the $VERSION baseline for $CPU in $BASELINE"
+    exit 0
+fi
+
+if [ ! -f "$BASELINE" ]; then
+    echo "Error: No baseline at $BASELINE. Create one with --update."
+    exit 2
+fi
+
+# Versions stored for this CPU, oldest first
+STORED=$(awk "$CSV_AWK"'NR > 1 { parseCsv($0, f); if (f[6] == ENVIRON["CPU"]) print f[1] }' "$BASELINE" | uniq)
+if [ -z "$STORED" ]; then
+    echo "Error: $BASELINE has no baseline for this CPU ($CPU). Create one with --update."
+    exit 2
+fi
+if [ -z "$AGAINST" ]; then
+    if grep -qxF "$VERSION" <<< "$STORED"; then
+        AGAINST="$VERSION"
+    else
+        AGAINST=$(tail -n 1 <<< "$STORED")
+    fi
+elif ! grep -qxF "$AGAINST" <<< "$STORED"; then
+    echo "Error: $BASELINE has no $AGAINST baseline for this CPU ($CPU)."
+    exit 2
+fi
+
+echo ""
+echo "Comparing version $VERSION with baseline $AGAINST on $CPU (slower than the tolerance plus both spreads fails)"
+echo ""
+
+# Exit status 1 if any configuration regressed
+awk -v against="$AGAINST" -v tolerance="$TOLERANCE" "$CSV_AWK"'
+    { parseCsv($0, f) }
+    NR == FNR {
+        if (FNR > 1 && f[1] == against && f[6] == ENVIRON["CPU"]) {
+            key = f[2] "," f[3] "," f[4] "," f[5]
+            base[key] = f[7]; baseSpread[key] = f[8]
+        }
+        next
+    }
+    FNR == 1 {
+        printf "%-8s %7s %-11s %-15s %11s %11s %8s %8s  %s\n", "Impl", "Bodies", "Solver", "Integrator", "Base ms", "Now ms", "Change", "Allowed", "Status"
+        next
+    }
+    {
+        key = f[2] "," f[3] "," f[4] "," f[5]
+        if (!(key in base)) {
+            printf "%-8s %7s %-11s %-15s %11s %11.4f %8s %8s  %s\n", f[2], f[3], f[4], f[5], "-", f[7], "-", "-", "new"
+            next
+        }
+        change = 100 * (f[7] - base[key]) / base[key]
+        allowed = tolerance + 100 * (f[8] + baseSpread[key])
+        status = "ok"
+        if (change > allowed) { status = "REGRESSED"; failed++ }
+        else if (-change > allowed) status = "faster"
+        printf "%-8s %7s %-11s %-15s %11.4f %11.4f %7.1f%% %7.1f%%  %s\n", f[2], f[3], f[4], f[5], base[key], f[7], change, allowed, status
+    }
+    END {
+        print ""
+        if (failed) { print failed " configuration(s) regressed."; exit 1 }
+        print "No regressions."
+    }' "$BASELINE" "$CURRENT"
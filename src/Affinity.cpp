@@ -0,0 +1,196 @@
+#include "Affinity.h"
+#include "ForceSolver.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+
+const char* affinityName(AffinityMode mode) {
+    switch (mode) {
+        case AffinityMode::None: return "none";
+        case AffinityMode::Compact: return "compact";
+        case AffinityMode::Spread: return "spread";
+    }
+    return "unknown";
+}
+
+bool parseAffinity(const std::string& name, AffinityMode& mode) {
+    if (name == "none" || name == "off") {
+        mode = AffinityMode::None;
+    } else if (name == "compact" || name == "close") {
+        mode = AffinityMode::Compact;
+    } else if (name == "spread") {
+        mode = AffinityMode::Spread;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+struct Cpu {
+    int cpu;
+    int node;
+    int package;
+    int core;
+    int sibling;  // Index among the hardware threads of its core
+};
+
+int readInt(const std::string& path, int fallback) {
+    std::ifstream file(path);
+    int value;
+    return (file >> value) ? value : fallback;
+}
+
+// Expand a sysfs CPU list such as "0-7,16-23"
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+            for (int c = first; c <= last; c++) cpus.push_back(c);
+        } catch (const std::exception&) {
+        }
+    }
+    return cpus;
+}
+
+// The CPUs the process started with, in placement order: node, package,
+// core, then hardware thread, so the first CPUs of every node are distinct
+// physical cores. Read once, before any thread is pinned.
+const std::vector<Cpu>& availableCpus() {
+    static const std::vector<Cpu> cpus = []() {
+        std::map<int, int> nodeOf;
+        for (int node = 0; node < 1024; node++) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!file) continue;
+            std::string list;
+            std::getline(file, list);
+            for (int c : parseCpuList(list)) nodeOf[c] = node;
+        }
+
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+
+        std::vector<Cpu> result;
+        std::map<std::pair<int, int>, int> siblings;
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (!CPU_ISSET(c, &allowed)) continue;
+            const std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/";
+            Cpu cpu;
+            cpu.cpu = c;
+            cpu.node = nodeOf.count(c) ? nodeOf[c] : 0;
+            cpu.package = readInt(topology + "physical_package_id", 0);
+            cpu.core = readInt(topology + "core_id", c);
+            cpu.sibling = siblings[{cpu.package, cpu.core}]++;
+            result.push_back(cpu);
+        }
+        std::sort(result.begin(), result.end(), [](const Cpu& a, const Cpu& b) {
+            if (a.node != b.node) return a.node < b.node;
+            if (a.sibling != b.sibling) return a.sibling < b.sibling;
+            if (a.package != b.package) return a.package < b.package;
+            if (a.core != b.core) return a.core < b.core;
+            return a.cpu < b.cpu;
+        });
+        return result;
+    }();
+    return cpus;
+}
+
+int nodeOfCpu(int cpu) {
+    for (const Cpu& c : availableCpus()) {
+        if (c.cpu == cpu) return c.node;
+    }
+    return 0;
+}
+
+// CPU for every thread number of a team of the given size
+std::vector<int> planPlacement(AffinityMode mode, int threads) {
+    const std::vector<Cpu>& cpus = availableCpus();
+    std::vector<int> plan(threads, -1);
+    if (cpus.empty()) return plan;
+
+    if (mode == AffinityMode::Compact) {
+        for (int t = 0; t < threads; t++) plan[t] = cpus[t % cpus.size()].cpu;
+        return plan;
+    }
+
+    // Spread: node k takes thread numbers [k * threads / nodes, (k + 1) * threads / nodes)
+    std::vector<std::vector<int>> byNode;
+    int lastNode = -1;
+    for (const Cpu& c : cpus) {
+        if (c.node != lastNode) {
+            byNode.emplace_back();
+            lastNode = c.node;
+        }
+        byNode.back().push_back(c.cpu);
+    }
+    const int nodes = static_cast<int>(byNode.size());
+    for (int k = 0; k < nodes; k++) {
+        const int first = k * threads / nodes;
+        const int last = (k + 1) * threads / nodes;
+        for (int t = first; t < last; t++) {
+            plan[t] = byNode[k][(t - first) % byNode[k].size()];
+        }
+    }
+    return plan;
+}
+
+bool pinCallingThread(int cpu) {
+    if (cpu < 0) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+} // namespace
+
+int numaNodeCount() {
+    std::vector<int> nodes;
+    for (const Cpu& c : availableCpus()) nodes.push_back(c.node);
+    std::sort(nodes.begin(), nodes.end());
+    return static_cast<int>(std::unique(nodes.begin(), nodes.end()) - nodes.begin());
+}
+
+std::vector<ThreadPlacement> pinThreads(ForceSolver& solver, AffinityMode mode) {
+    if (mode == AffinityMode::None) return currentPlacement(solver);
+
+    const std::vector<int> plan = planPlacement(mode, solver.threadCount());
+    std::atomic<bool> failed(false);
+    solver.forEachThread([&](int thread) {
+        if (!pinCallingThread(plan[thread])) failed = true;
+    });
+    if (failed) {
+        std::cerr << "Warning: Could not pin every thread; placement is partly left to the OS." << std::endl;
+    }
+    return currentPlacement(solver);
+}
+
+std::vector<ThreadPlacement> currentPlacement(ForceSolver& solver) {
+    std::vector<ThreadPlacement> placement(solver.threadCount());
+    solver.forEachThread([&](int thread) {
+        const int cpu = sched_getcpu();
+        placement[thread] = ThreadPlacement{thread, cpu, nodeOfCpu(cpu)};
+    });
+    return placement;
+}
+
+void printPlacement(std::ostream& out, AffinityMode mode, const std::vector<ThreadPlacement>& placement) {
+    out << "Thread placement (" << affinityName(mode) << ", " << numaNodeCount() << " NUMA node"
+        << (numaNodeCount() == 1 ? "" : "s") << "):";
+    for (const ThreadPlacement& p : placement) {
+        out << " " << p.thread << "->cpu" << p.cpu << "/n" << p.node;
+    }
+    out << std::endl;
+}
@@ -0,0 +1,217 @@
+#include "BarnesHut.h"
+#include "BodyStore.h"
+#include <algorithm>
+#include <cmath>
+
+int QuadTree::childIndex(const Node& node, float x, float y) const {
+    return (x >= node.centerX ? 1 : 0) + (y >= node.centerY ? 2 : 0);
+}
+
+void QuadTree::subdivide(int nodeIndex) {
+    const Node parent = nodes[nodeIndex];
+    const float quarter = parent.halfSize * 0.5f;
+
+    nodes[nodeIndex].firstChild = static_cast<int>(nodes.size());
+    for (int c = 0; c < 4; c++) {
+        Node child;
+        child.centerX = parent.centerX + ((c & 1) ? quarter : -quarter);
+        child.centerY = parent.centerY + ((c & 2) ? quarter : -quarter);
+        child.halfSize = quarter;
+        child.mass = 0.0f;
+        child.comX = child.centerX;
+        child.comY = child.centerY;
+        child.firstChild = -1;
+        child.body = -1;
+        nodes.push_back(child);
+    }
+}
+
+void QuadTree::insert(int bodyIndex) {
+    const float x = posX[bodyIndex];
+    const float y = posY[bodyIndex];
+    int nodeIndex = 0;
+    int depth = 0;
+
+    while (true) {
+        // Descend through internal cells
+        if (nodes[nodeIndex].firstChild >= 0) {
+            nodeIndex = nodes[nodeIndex].firstChild + childIndex(nodes[nodeIndex], x, y);
+            depth++;
+            continue;
+        }
+
+        // Empty leaf: store the body here
+        if (nodes[nodeIndex].body < 0) {
+            nodes[nodeIndex].body = bodyIndex;
+            return;
+        }
+
+        // Too deep to split any further: chain the body into the leaf
+        if (depth >= MAX_DEPTH) {
+            nextInLeaf[bodyIndex] = nodes[nodeIndex].body;
+            nodes[nodeIndex].body = bodyIndex;
+            return;
+        }
+
+        // Occupied leaf: split it and push the resident body one level down
+        int resident = nodes[nodeIndex].body;
+        subdivide(nodeIndex);
+        nodes[nodeIndex].body = -1;
+        int child = nodes[nodeIndex].firstChild +
+                    childIndex(nodes[nodeIndex], posX[resident], posY[resident]);
+        nodes[child].body = resident;
+    }
+}
+
+void QuadTree::computeMassDistribution() {
+    // Children are always created after their parent, so a reverse sweep
+    // visits every cell after all of its descendants
+    for (size_t k = nodes.size(); k-- > 0;) {
+        Node& node = nodes[k];
+        float m = 0.0f, mx = 0.0f, my = 0.0f;
+
+        if (node.firstChild < 0) {
+            for (int b = node.body; b >= 0; b = nextInLeaf[b]) {
+                m += mass[b];
+                mx += mass[b] * posX[b];
+                my += mass[b] * posY[b];
+            }
+        } else {
+            for (int c = 0; c < 4; c++) {
+                const Node& child = nodes[node.firstChild + c];
+                m += child.mass;
+                mx += child.mass * child.comX;
+                my += child.mass * child.comY;
+            }
+        }
+
+        node.mass = m;
+        if (m > 0.0f) {
+            node.comX = mx / m;
+            node.comY = my / m;
+        }
+    }
+}
+
+void QuadTree::build(const BodyStore& bodies) {
+    const size_t n = bodies.size();
+    nodes.clear();
+    nextInLeaf.assign(n, -1);
+
+    // Keep a private copy so the tree stays valid while the bodies move on
+    posX.assign(bodies.x.begin(), bodies.x.end());
+    posY.assign(bodies.y.begin(), bodies.y.end());
+    mass.assign(bodies.mass.begin(), bodies.mass.end());
+
+    if (n == 0) return;
+
+    float minX = posX[0], maxX = minX;
+    float minY = posY[0], maxY = minY;
+    for (size_t i = 1; i < n; i++) {
+        minX = std::min(minX, posX[i]);
+        maxX = std::max(maxX, posX[i]);
+        minY = std::min(minY, posY[i]);
+        maxY = std::max(maxY, posY[i]);
+    }
+
+    // Square root cell, slightly enlarged so bodies on the border fall inside
+    Node root;
+    root.centerX = 0.5f * (minX + maxX);
+    root.centerY = 0.5f * (minY + maxY);
+    root.halfSize = 0.5f * std::max(maxX - minX, maxY - minY) * 1.001f + 1e-3f;
+    root.mass = 0.0f;
+    root.comX = root.centerX;
+    root.comY = root.centerY;
+    root.firstChild = -1;
+    root.body = -1;
+
+    // A quadtree over n bodies has roughly 2n cells
+    nodes.reserve(2 * n + 4);
+    nodes.push_back(root);
+
+    for (size_t i = 0; i < n; i++) {
+        insert(static_cast<int>(i));
+    }
+
+    computeMassDistribution();
+}
+
+sf::Vector2f QuadTree::accelerationOn(size_t i, float theta, float G, float softening) const {
+    sf::Vector2f acc(0.0f, 0.0f);
+    if (nodes.empty()) return acc;
+
+    const float xi = posX[i];
+    const float yi = posY[i];
+    const float eps2 = softening * softening;
+    const int self = static_cast<int>(i);
+
+    // Each visited cell replaces itself with at most 4 children
+    int stack[4 * MAX_DEPTH + 4];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (node.mass <= 0.0f) continue;
+
+        if (node.firstChild < 0) {
+            // Leaves are summed exactly, skipping the body itself
+            for (int b = node.body; b >= 0; b = nextInLeaf[b]) {
+                if (b == self) continue;
+                float dx = posX[b] - xi;
+                float dy = posY[b] - yi;
+                float distSquared = dx * dx + dy * dy + eps2;
+                float invDistance = 1.0f / std::sqrt(distSquared);
+                float scale = G * mass[b] * invDistance * invDistance * invDistance;
+                acc.x += dx * scale;
+                acc.y += dy * scale;
+            }
+            continue;
+        }
+
+        float dx = node.comX - xi;
+        float dy = node.comY - yi;
+        float d2 = dx * dx + dy * dy;
+
+        // Opening test on size / theta plus the offset of the center of mass
+        // from the cell center, so lopsided cells are not accepted too early
+        float offX = node.comX - node.centerX;
+        float offY = node.comY - node.centerY;
+        float reach = 2.0f * node.halfSize / theta + std::sqrt(offX * offX + offY * offY);
+
+        if (reach * reach < d2) {
+            // Far enough away: treat the whole cell as a point mass
+            float distSquared = d2 + eps2;
+            float invDistance = 1.0f / std::sqrt(distSquared);
+            float scale = G * node.mass * invDistance * invDistance * invDistance;
+            acc.x += dx * scale;
+            acc.y += dy * scale;
+        } else {
+            for (int c = 0; c < 4; c++) {
+                stack[top++] = node.firstChild + c;
+            }
+        }
+    }
+
+    return acc;
+}
+
+ForceError measureBarnesHutError(const BodyStore& bodies, float theta,
+                                 float G, float softening, int samples) {
+    const size_t n = bodies.size();
+    if (n < 2 || samples <= 0) return ForceError{0.0f, 0.0f, 0};
+
+    QuadTree tree;
+    tree.build(bodies);
+
+    // Only the sampled bodies are compared, but walking all of them is cheap
+    std::vector<float> ax(n), ay(n);
+    for (size_t i = 0; i < n; i++) {
+        sf::Vector2f acc = tree.accelerationOn(i, theta, G, softening);
+        ax[i] = acc.x;
+        ay[i] = acc.y;
+    }
+
+    return compareWithDirectSum(bodies.x.data(), bodies.y.data(), bodies.mass.data(), n,
+                                ax.data(), ay.data(), G, softening * softening, samples);
+}
@@ -1,56 +1,225 @@
 #include "Benchmark.hpp"
+#include "version.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
 
-Benchmark::Benchmark(const std::string& impl, int bodies) 
-    : implementation(impl), numBodies(bodies), totalFPS(0.0), frameCount(0) {
+// FrameHistogram implementation
+int FrameHistogram::bucketOf(double seconds) {
+    double scaled = std::max(seconds / MIN_SECONDS, 1.0);
+    int exponent;
+    double mantissa = std::frexp(scaled, &exponent);   // scaled = mantissa * 2^exponent, mantissa in [0.5, 1)
+    int octave = exponent - 1;
+    if (octave >= OCTAVES) return SUB_BUCKETS * OCTAVES - 1;
+    int sub = static_cast<int>((mantissa * 2.0 - 1.0) * SUB_BUCKETS);
+    return octave * SUB_BUCKETS + std::min(sub, SUB_BUCKETS - 1);
 }
 
-void Benchmark::addFrame(double fps) {
-    // Skip the first 100 frames to avoid initialization overhead
-    if (frameCount >= 100) {
-        totalFPS += fps;
+double FrameHistogram::bucketMidpoint(int bucket) {
+    int octave = bucket / SUB_BUCKETS;
+    int sub = bucket % SUB_BUCKETS;
+    return MIN_SECONDS * std::ldexp(1.0 + (sub + 0.5) / SUB_BUCKETS, octave);
+}
+
+void FrameHistogram::add(double seconds) {
+    buckets[bucketOf(seconds)]++;
+    count++;
+    sum += seconds;
+    max = std::max(max, seconds);
+}
+
+void FrameHistogram::clear() {
+    buckets.fill(0);
+    count = 0;
+    sum = 0.0;
+    max = 0.0;
+}
+
+double FrameHistogram::percentile(double p) const {
+    if (count == 0) return 0.0;
+    uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * count));
+    rank = std::min(std::max<uint64_t>(rank, 1), count);
+
+    uint64_t seen = 0;
+    for (size_t b = 0; b < buckets.size(); b++) {
+        seen += buckets[b];
+        if (seen >= rank) return std::min(bucketMidpoint(static_cast<int>(b)), max);
+    }
+    return max;
+}
+
+// Benchmark implementation
+Benchmark::Benchmark(const std::string& impl, int bodies)
+    : implementation(impl), numBodies(bodies), warmedUp(false), warmupFrames(0),
+      warmupSeconds(0.0), windowSum(0.0), windowFrames(0), previousWindowMean(0.0) {
+}
+
+void Benchmark::addFrameTime(double seconds) {
+    if (warmedUp) {
+        histogram.add(seconds);
+        return;
+    }
+
+    warmupFrames++;
+    warmupSeconds += seconds;
+    windowSum += seconds;
+    windowFrames++;
+
+    if (windowFrames == WARMUP_WINDOW) {
+        // Steady once a window's mean frame time matches the previous one
+        double mean = windowSum / windowFrames;
+        if (previousWindowMean > 0.0 &&
+            std::fabs(mean - previousWindowMean) <= WARMUP_TOLERANCE * previousWindowMean) {
+            warmedUp = true;
+        }
+        previousWindowMean = mean;
+        windowSum = 0.0;
+        windowFrames = 0;
+    }
+
+    // Slow or noisy runs never settle; stop waiting after a bounded warm-up
+    if (warmupFrames >= MAX_WARMUP_FRAMES || warmupSeconds >= MAX_WARMUP_SECONDS) {
+        warmedUp = true;
     }
-    frameCount++;
 }
 
 double Benchmark::getAverageFPS() const {
-    if (frameCount <= 100) return 0.0;
-    return totalFPS / (frameCount - 100);
+    if (histogram.getSum() <= 0.0) return 0.0;
+    return histogram.getCount() / histogram.getSum();
+}
+
+void Benchmark::printSummary(std::ostream& out) const {
+    out << std::fixed << std::setprecision(3)
+        << "Frames: " << histogram.getCount() << " measured after " << warmupFrames << " warm-up"
+        << ", frame time p50 " << histogram.percentile(50) * 1e3
+        << " ms, p95 " << histogram.percentile(95) * 1e3
+        << " ms, p99 " << histogram.percentile(99) * 1e3
+        << " ms, max " << histogram.getMax() * 1e3 << " ms" << std::endl;
+}
+
+std::string cpuModelName() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                size_t start = line.find_first_not_of(" \t", colon + 1);
+                if (start != std::string::npos) return line.substr(start);
+            }
+        }
+    }
+    return "unknown";
+}
+
+std::string csvField(const std::string& text) {
+    std::string result = "\"";
+    for (char c : text) {
+        if (c == '"') result += '"';
+        result += c;
+    }
+    return result + "\"";
 }
 
+namespace {
+
+std::string jsonString(const std::string& text) {
+    std::string result = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+const char* CSV_HEADER = "Implementation,NumBodies,AverageFPS,Frames,WarmupFrames,"
+                         "MeanMs,P50Ms,P95Ms,P99Ms,MaxMs,Threads,Dt,Softening,"
+                         "Solver,Integrator,CPU,Version";
+
+} // namespace
+
 void Benchmark::saveResults(const std::string& filename) {
-    if (frameCount <= 100) {
+    if (histogram.getCount() == 0) {
         std::cout << "Not enough frames recorded for benchmark." << std::endl;
         return;
     }
-    
-    double avgFPS = getAverageFPS();
-    
+
+    const bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+    if (json) {
+        writeJson(filename);
+    } else {
+        writeCsv(filename);
+    }
+
+    std::cout << "Benchmark saved: " << implementation << " with " << numBodies
+              << " bodies, Average FPS: " << std::fixed << std::setprecision(2)
+              << getAverageFPS() << ", p99 frame " << std::setprecision(3)
+              << histogram.percentile(99) * 1e3 << " ms" << std::endl;
+}
+
+void Benchmark::writeCsv(const std::string& filename) const {
     // Check if file exists to determine if we need to write header
     std::ifstream checkFile(filename);
     bool fileExists = checkFile.good();
+    std::string header;
+    if (fileExists) std::getline(checkFile, header);
     checkFile.close();
-    
+
+    if (fileExists && header != CSV_HEADER) {
+        std::cerr << "Warning: " << filename << " has a different header; appending anyway." << std::endl;
+    }
+
     // Open file in append mode
     std::ofstream file(filename, std::ios::app);
     if (!file.is_open()) {
         std::cerr << "Error: Could not open " << filename << " for writing." << std::endl;
         return;
     }
-    
+
     // Write header if file is new
     if (!fileExists) {
-        file << "Implementation,NumBodies,AverageFPS\n";
+        file << CSV_HEADER << "\n";
     }
-    
+
     // Write data
-    file << implementation << "," << numBodies << "," 
-         << std::fixed << std::setprecision(2) << avgFPS << "\n";
-    
-    file.close();
-    
-    std::cout << "Benchmark saved: " << implementation << " with " << numBodies 
-              << " bodies, Average FPS: " << std::fixed << std::setprecision(2) 
-              << avgFPS << std::endl;
+    file << implementation << "," << numBodies << ","
+         << std::fixed << std::setprecision(2) << getAverageFPS() << ","
+         << histogram.getCount() << "," << warmupFrames << ","
+         << std::setprecision(4)
+         << histogram.getMean() * 1e3 << "," << histogram.percentile(50) * 1e3 << ","
+         << histogram.percentile(95) * 1e3 << "," << histogram.percentile(99) * 1e3 << ","
+         << histogram.getMax() * 1e3 << ","
+         << metadata.threads << "," << std::setprecision(6) << metadata.dt << ","
+         << std::setprecision(2) << metadata.softening << ","
+         << csvField(metadata.solver) << "," << csvField(metadata.integrator) << ","
+         << csvField(cpuModelName()) << "," << csvField(Version::get_full_info()) << "\n";
+}
+
+void Benchmark::writeJson(const std::string& filename) const {
+    std::ofstream file(filename, std::ios::app);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open " << filename << " for writing." << std::endl;
+        return;
+    }
+
+    file << std::fixed << std::setprecision(4)
+         << "{\"implementation\":" << jsonString(implementation)
+         << ",\"bodies\":" << numBodies
+         << ",\"average_fps\":" << getAverageFPS()
+         << ",\"frames\":" << histogram.getCount()
+         << ",\"warmup_frames\":" << warmupFrames
+         << ",\"frame_ms\":{\"mean\":" << histogram.getMean() * 1e3
+         << ",\"p50\":" << histogram.percentile(50) * 1e3
+         << ",\"p95\":" << histogram.percentile(95) * 1e3
+         << ",\"p99\":" << histogram.percentile(99) * 1e3
+         << ",\"max\":" << histogram.getMax() * 1e3 << "}"
+         << ",\"threads\":" << metadata.threads
+         << std::setprecision(6) << ",\"dt\":" << metadata.dt
+         << ",\"softening\":" << metadata.softening
+         << ",\"solver\":" << jsonString(metadata.solver)
+         << ",\"integrator\":" << jsonString(metadata.integrator)
+         << ",\"cpu\":" << jsonString(cpuModelName())
+         << ",\"version\":" << jsonString(Version::get_full_info()) << "}\n";
 }
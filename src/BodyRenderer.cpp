@@ -0,0 +1,58 @@
+#include "BodyRenderer.h"
+#include "SimulationRunner.h"
+#include <algorithm>
+#include <cmath>
+
+BodyRenderer::BodyRenderer() : vertices(sf::Triangles) {
+    createCircleTexture();
+}
+
+void BodyRenderer::createCircleTexture() {
+    // One pixel of soft edge so small bodies don't shimmer when they move
+    sf::Image image;
+    image.create(TEXTURE_SIZE, TEXTURE_SIZE, sf::Color::Transparent);
+    const float center = 0.5f * TEXTURE_SIZE;
+    for (unsigned py = 0; py < TEXTURE_SIZE; py++) {
+        for (unsigned px = 0; px < TEXTURE_SIZE; px++) {
+            float dx = px + 0.5f - center;
+            float dy = py + 0.5f - center;
+            float coverage = std::min(1.0f, std::max(0.0f, center - std::sqrt(dx * dx + dy * dy)));
+            image.setPixel(px, py, sf::Color(255, 255, 255, static_cast<sf::Uint8>(255.0f * coverage)));
+        }
+    }
+
+    circleTexture.loadFromImage(image);
+    circleTexture.setSmooth(true);
+    circleTexture.generateMipmap();
+}
+
+void BodyRenderer::update(const BodySnapshot& bodies) {
+    const std::size_t n = bodies.size();
+    vertices.resize(n * VERTICES_PER_BODY);
+
+    const float* x = bodies.x.data();
+    const float* y = bodies.y.data();
+    const float* radius = bodies.radius.data();
+    const sf::Color* color = bodies.color.data();
+    const float t = static_cast<float>(TEXTURE_SIZE);
+
+    // Every body owns its own six vertices, so the fill splits cleanly
+    #pragma omp parallel for schedule(static)
+    for (std::size_t i = 0; i < n; i++) {
+        const float left = x[i] - radius[i], right = x[i] + radius[i];
+        const float top = y[i] - radius[i], bottom = y[i] + radius[i];
+        sf::Vertex* quad = &vertices[i * VERTICES_PER_BODY];
+
+        quad[0] = sf::Vertex(sf::Vector2f(left, top), color[i], sf::Vector2f(0.0f, 0.0f));
+        quad[1] = sf::Vertex(sf::Vector2f(right, top), color[i], sf::Vector2f(t, 0.0f));
+        quad[2] = sf::Vertex(sf::Vector2f(right, bottom), color[i], sf::Vector2f(t, t));
+        quad[3] = quad[0];
+        quad[4] = quad[2];
+        quad[5] = sf::Vertex(sf::Vector2f(left, bottom), color[i], sf::Vector2f(0.0f, t));
+    }
+}
+
+void BodyRenderer::draw(sf::RenderTarget& target) const {
+    if (vertices.getVertexCount() == 0) return;
+    target.draw(vertices, sf::RenderStates(&circleTexture));
+}
@@ -0,0 +1,139 @@
+#include "BodyStore.h"
+
+namespace {
+
+// Gather one array through the permutation, reusing a buffer of its type.
+// The buffer keeps the array's capacity, so later insertions still fit.
+template <typename Vector>
+void gather(Vector& values, const std::vector<uint32_t>& order, Vector& buffer) {
+    buffer.reserve(values.capacity());
+    buffer.resize(values.size());
+    for (std::size_t k = 0; k < order.size(); k++) {
+        buffer[k] = values[order[k]];
+    }
+    values.swap(buffer);
+}
+
+} // namespace
+
+void BodyStore::clear() {
+    x.clear();
+    y.clear();
+    vx.clear();
+    vy.clear();
+    ax.clear();
+    ay.clear();
+    mass.clear();
+    radius.clear();
+    color.clear();
+    id.clear();
+    nextId = 0;
+}
+
+void BodyStore::reserve(std::size_t n) {
+    x.reserve(n);
+    y.reserve(n);
+    vx.reserve(n);
+    vy.reserve(n);
+    ax.reserve(n);
+    ay.reserve(n);
+    mass.reserve(n);
+    radius.reserve(n);
+    color.reserve(n);
+    id.reserve(n);
+}
+
+void BodyStore::resize(std::size_t n) {
+    x.resize(n);
+    y.resize(n);
+    vx.resize(n);
+    vy.resize(n);
+    ax.resize(n);
+    ay.resize(n);
+    mass.resize(n);
+    radius.resize(n);
+    color.resize(n);
+    id.resize(n);
+}
+
+void BodyStore::emplace_back(sf::Vector2f pos, sf::Vector2f vel, float m, float r, sf::Color c) {
+    x.push_back(pos.x);
+    y.push_back(pos.y);
+    vx.push_back(vel.x);
+    vy.push_back(vel.y);
+    ax.push_back(0.0f);
+    ay.push_back(0.0f);
+    mass.push_back(m);
+    radius.push_back(r);
+    color.push_back(c);
+    id.push_back(nextId++);
+}
+
+void BodyStore::push_back(const Body& body) {
+    emplace_back(body.getPosition(), body.getVelocity(), body.getMass(),
+                 body.getRadius(), body.getColor());
+}
+
+void BodyStore::append(const BodyStore& batch) {
+    // Each insert grows geometrically when it has to, so appends are
+    // amortized O(batch)
+    x.insert(x.end(), batch.x.begin(), batch.x.end());
+    y.insert(y.end(), batch.y.begin(), batch.y.end());
+    vx.insert(vx.end(), batch.vx.begin(), batch.vx.end());
+    vy.insert(vy.end(), batch.vy.begin(), batch.vy.end());
+    ax.insert(ax.end(), batch.ax.begin(), batch.ax.end());
+    ay.insert(ay.end(), batch.ay.begin(), batch.ay.end());
+    mass.insert(mass.end(), batch.mass.begin(), batch.mass.end());
+    radius.insert(radius.end(), batch.radius.begin(), batch.radius.end());
+    color.insert(color.end(), batch.color.begin(), batch.color.end());
+    for (std::size_t k = 0; k < batch.size(); k++) id.push_back(nextId++);
+}
+
+void BodyStore::swapRemove(std::size_t i) {
+    const std::size_t last = size() - 1;
+    if (i != last) {
+        x[i] = x[last];
+        y[i] = y[last];
+        vx[i] = vx[last];
+        vy[i] = vy[last];
+        ax[i] = ax[last];
+        ay[i] = ay[last];
+        mass[i] = mass[last];
+        radius[i] = radius[last];
+        color[i] = color[last];
+        id[i] = id[last];
+    }
+    x.pop_back();
+    y.pop_back();
+    vx.pop_back();
+    vy.pop_back();
+    ax.pop_back();
+    ay.pop_back();
+    mass.pop_back();
+    radius.pop_back();
+    color.pop_back();
+    id.pop_back();
+}
+
+Body BodyStore::get(std::size_t i) const {
+    return Body(sf::Vector2f(x[i], y[i]), sf::Vector2f(vx[i], vy[i]),
+                mass[i], radius[i], color[i]);
+}
+
+void BodyStore::permute(const std::vector<uint32_t>& order) {
+    AlignedVector<float> floats;
+    gather(x, order, floats);
+    gather(y, order, floats);
+    gather(vx, order, floats);
+    gather(vy, order, floats);
+    gather(ax, order, floats);
+    gather(ay, order, floats);
+    gather(mass, order, floats);
+
+    std::vector<float> radii;
+    gather(radius, order, radii);
+    std::vector<sf::Color> colors;
+    gather(color, order, colors);
+    std::vector<uint32_t> ids;
+    gather(id, order, ids);
+}
@@ -0,0 +1,337 @@
+#include "Checkpoint.h"
+#include "Simulation.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'C', 'K', 'P'};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const uint64_t ALIGNMENT = 64;
+
+// Every array holds one 4-byte value per body
+static_assert(sizeof(sf::Color) == 4, "colors are stored as 4 bytes");
+const uint64_t ELEMENT_SIZE = 4;
+
+uint64_t alignUp(uint64_t value) {
+    return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+const void* arrayData(const BodyStore& bodies, uint32_t which) {
+    switch (which) {
+        case ArrayX: return bodies.x.data();
+        case ArrayY: return bodies.y.data();
+        case ArrayVx: return bodies.vx.data();
+        case ArrayVy: return bodies.vy.data();
+        case ArrayAx: return bodies.ax.data();
+        case ArrayAy: return bodies.ay.data();
+        case ArrayMass: return bodies.mass.data();
+        case ArrayRadius: return bodies.radius.data();
+        case ArrayColor: return bodies.color.data();
+        case ArrayId: return bodies.id.data();
+    }
+    return nullptr;
+}
+
+// Header with the array offsets laid out for n bodies
+CheckpointHeader makeHeader(const CheckpointParameters& parameters, uint64_t n) {
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = CHECKPOINT_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.headerSize = alignUp(sizeof(CheckpointHeader));
+    header.bodyCount = n;
+    header.parameters = parameters;
+
+    uint64_t offset = header.headerSize;
+    for (uint32_t a = 0; a < CHECKPOINT_ARRAYS; a++) {
+        header.arrayOffset[a] = offset;
+        offset = alignUp(offset + n * ELEMENT_SIZE);
+    }
+    header.fileSize = offset;
+    return header;
+}
+
+} // namespace
+
+bool writeCheckpoint(const std::string& path, const CheckpointParameters& parameters,
+                     const BodyStore& bodies, std::string& error) {
+    const CheckpointHeader header = makeHeader(parameters, bodies.size());
+    const std::string temporary = path + ".tmp";
+
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        error = "could not open " + temporary + " for writing";
+        return false;
+    }
+
+    static const char padding[ALIGNMENT] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding, header.headerSize - sizeof(header));
+    for (uint32_t a = 0; a < CHECKPOINT_ARRAYS; a++) {
+        const uint64_t bytes = header.bodyCount * ELEMENT_SIZE;
+        if (bytes > 0) file.write(static_cast<const char*>(arrayData(bodies, a)), bytes);
+        file.write(padding, alignUp(bytes) - bytes);
+    }
+    file.close();
+    if (!file) {
+        std::remove(temporary.c_str());
+        error = "could not write " + temporary;
+        return false;
+    }
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        error = "could not replace " + path;
+        return false;
+    }
+    return true;
+}
+
+MappedCheckpoint::~MappedCheckpoint() {
+    if (data) munmap(const_cast<unsigned char*>(data), length);
+}
+
+bool MappedCheckpoint::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "could not open " + path;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(CheckpointHeader)) {
+        ::close(fd);
+        error = path + " is too short to be a checkpoint";
+        return false;
+    }
+
+    length = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        length = 0;
+        error = "could not map " + path;
+        return false;
+    }
+    data = static_cast<const unsigned char*>(mapping);
+
+    // Start reading ahead while the header is checked
+    madvise(mapping, length, MADV_WILLNEED);
+
+    const CheckpointHeader& h = header();
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = path + " is not a checkpoint";
+    } else if (h.byteOrder != BYTE_ORDER_MARK) {
+        error = path + " was written on a machine with another byte order";
+    } else if (h.version != CHECKPOINT_VERSION) {
+        error = path + " has checkpoint version " + std::to_string(h.version) +
+                ", expected " + std::to_string(CHECKPOINT_VERSION);
+    } else if (h.fileSize != length || h.headerSize < sizeof(CheckpointHeader)) {
+        error = path + " is truncated or corrupt";
+    } else {
+        bool tableValid = true;
+        for (uint32_t a = 0; a < CHECKPOINT_ARRAYS; a++) {
+            const uint64_t offset = h.arrayOffset[a];
+            tableValid = tableValid && offset % ALIGNMENT == 0 && offset >= h.headerSize &&
+                         offset + h.bodyCount * ELEMENT_SIZE <= length;
+        }
+        if (tableValid) return true;
+        error = path + " has a corrupt array table";
+    }
+
+    munmap(mapping, length);
+    data = nullptr;
+    length = 0;
+    return false;
+}
+
+CheckpointWriter::CheckpointWriter() : busy(false), stopping(false) {
+    worker = std::thread(&CheckpointWriter::run, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+}
+
+bool CheckpointWriter::submit(const std::string& path, const CheckpointParameters& parameters,
+                              BodyStore&& bodies) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (busy) return false;
+        pendingPath = path;
+        pendingParameters = parameters;
+        pendingBodies = std::move(bodies);
+        busy = true;
+    }
+    changed.notify_all();
+    return true;
+}
+
+void CheckpointWriter::wait() {
+    std::unique_lock<std::mutex> guard(lock);
+    changed.wait(guard, [this]() { return !busy; });
+}
+
+void CheckpointWriter::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        // A queued snapshot is written before the thread stops
+        changed.wait(guard, [this]() { return busy || stopping; });
+        if (!busy) return;
+
+        guard.unlock();
+        std::string error;
+        if (writeCheckpoint(pendingPath, pendingParameters, pendingBodies, error)) {
+            std::cout << "Checkpoint saved: " << pendingBodies.size() << " bodies, step "
+                      << pendingParameters.stepCount << ", " << pendingPath << std::endl;
+        } else {
+            std::cerr << "Error: Checkpoint not saved, " << error << "." << std::endl;
+        }
+        guard.lock();
+
+        pendingBodies = BodyStore();
+        busy = false;
+        changed.notify_all();
+    }
+}
+
+bool Simulation::saveCheckpoint(CheckpointWriter& writer, const std::string& path) const {
+    // Skip the copy if it would be refused anyway
+    if (writer.isBusy()) return false;
+
+    CheckpointParameters p;
+    std::memset(&p, 0, sizeof(p));
+    p.gravitationalConstant = gravitationalConstant;
+    p.softening = softening;
+    p.timeStep = timeStep;
+    p.width = width;
+    p.height = height;
+    p.theta = theta;
+    p.forceMethod = static_cast<int32_t>(forceMethod);
+    p.integrator = static_cast<int32_t>(integrator);
+    p.directMode = static_cast<int32_t>(directMode);
+    p.blockMaxLevel = blockSteps.maxLevel;
+    p.blockAccuracy = blockSteps.accuracy;
+    p.reorderCurve = static_cast<int32_t>(reorder.curve);
+    p.reorderInterval = reorder.interval;
+    p.meshGridSize = mesh.getSettings().gridSize;
+    p.meshAssignment = static_cast<int32_t>(mesh.getSettings().assignment);
+    p.meshShortRange = mesh.getSettings().shortRange ? 1 : 0;
+    p.accelerationsValid = accelerationsValid ? 1 : 0;
+    p.nextId = bodies.nextId;
+    p.stepCount = stepCount;
+    p.forceEvaluations = forceEvaluations;
+    p.distribution = static_cast<int32_t>(initialConditions.distribution);
+    p.initialBodyCount = initialBodyCount;
+    p.seed = initialConditions.seed;
+    p.maxMassSmall = initialConditions.maxMassSmall;
+    p.maxMassBig = initialConditions.maxMassBig;
+
+    // One memcpy per array here; the disk write happens on the writer's thread
+    PROFILE_SCOPE("checkpoint copy");
+    BodyStore snapshot(bodies);
+    return writer.submit(path, p, std::move(snapshot));
+}
+
+bool Simulation::loadCheckpoint(const std::string& path, std::string& error) {
+    PROFILE_SCOPE("checkpoint load");
+    MappedCheckpoint file;
+    if (!file.open(path, error)) return false;
+
+    const CheckpointParameters& p = file.header().parameters;
+    if (p.forceMethod < 0 || p.forceMethod > static_cast<int32_t>(ForceMethod::ParticleMesh) ||
+        p.integrator < 0 || p.integrator > static_cast<int32_t>(Integrator::BlockLeapfrog) ||
+        p.directMode < 0 || p.directMode > static_cast<int32_t>(DirectSumMode::FullRow) ||
+        p.reorderCurve < 0 || p.reorderCurve > static_cast<int32_t>(SpaceFillingCurve::Hilbert) ||
+        p.meshAssignment < 0 || p.meshAssignment > static_cast<int32_t>(MassAssignment::TSC) ||
+        p.distribution < 0 || p.distribution > static_cast<int32_t>(Distribution::Galaxies)) {
+        error = path + " holds settings this version does not know";
+        return false;
+    }
+    // Sizes that drive allocations and loops, in the ranges the command line
+    // accepts; the FFT needs a power of two
+    const int32_t grid = p.meshGridSize;
+    if (p.blockMaxLevel < 0 || p.blockMaxLevel > 20 ||
+        grid < 16 || grid > 8192 || (grid & (grid - 1)) != 0) {
+        error = path + " holds a block level or mesh size out of range";
+        return false;
+    }
+
+    // Ids are never reused, so every stored one must lie below the next
+    const size_t n = file.bodyCount();
+    const uint32_t* ids = file.array<uint32_t>(ArrayId);
+    if (n > 0 && *std::max_element(ids, ids + n) >= p.nextId) {
+        error = path + " holds ids beyond its next id";
+        return false;
+    }
+
+    gravitationalConstant = p.gravitationalConstant;
+    softening = p.softening;
+    timeStep = p.timeStep;
+    width = p.width;
+    height = p.height;
+    theta = p.theta;
+    forceMethod = static_cast<ForceMethod>(p.forceMethod);
+    integrator = static_cast<Integrator>(p.integrator);
+    directMode = static_cast<DirectSumMode>(p.directMode);
+    blockSteps.maxLevel = p.blockMaxLevel;
+    blockSteps.accuracy = p.blockAccuracy;
+    reorder.curve = static_cast<SpaceFillingCurve>(p.reorderCurve);
+    reorder.interval = p.reorderInterval;
+    ParticleMesh::Settings meshSettings;
+    meshSettings.gridSize = p.meshGridSize;
+    meshSettings.assignment = static_cast<MassAssignment>(p.meshAssignment);
+    meshSettings.shortRange = p.meshShortRange != 0;
+    mesh.setSettings(meshSettings);
+    accelerationsValid = p.accelerationsValid != 0;
+    velocityLag = -1.0f;
+    stepLevel.clear();
+    stepCount = p.stepCount;
+    forceEvaluations = p.forceEvaluations;
+    initialConditions.distribution = static_cast<Distribution>(p.distribution);
+    initialConditions.seed = p.seed;
+    initialConditions.maxMassSmall = p.maxMassSmall;
+    initialConditions.maxMassBig = p.maxMassBig;
+    initialBodyCount = p.initialBodyCount;
+
+    // Fresh arrays, so the copy below is their first touch
+    bodies = BodyStore();
+    bodies.resize(n);
+
+    // The hot arrays are copied by the backend's static split, which places
+    // them like placeBodies would; the render-only ones in one go
+    const float* source[7] = {file.array<float>(ArrayX), file.array<float>(ArrayY),
+                              file.array<float>(ArrayVx), file.array<float>(ArrayVy),
+                              file.array<float>(ArrayAx), file.array<float>(ArrayAy),
+                              file.array<float>(ArrayMass)};
+    float* target[7] = {bodies.x.data(), bodies.y.data(), bodies.vx.data(), bodies.vy.data(),
+                        bodies.ax.data(), bodies.ay.data(), bodies.mass.data()};
+    solver->forEachRange(n, [&](size_t begin, size_t end) {
+        for (int a = 0; a < 7; a++) {
+            std::memcpy(target[a] + begin, source[a] + begin, (end - begin) * sizeof(float));
+        }
+    });
+    if (n > 0) {
+        std::memcpy(bodies.radius.data(), file.array<float>(ArrayRadius), n * sizeof(float));
+        std::memcpy(static_cast<void*>(bodies.color.data()), file.array<sf::Color>(ArrayColor), n * sizeof(sf::Color));
+        std::memcpy(bodies.id.data(), file.array<uint32_t>(ArrayId), n * sizeof(uint32_t));
+    }
+    bodies.nextId = p.nextId;
+    bodiesPlaced = true;
+    indexOfIdValid = false;
+    return true;
+}
@@ -1,6 +1,11 @@
 #include "Extra.h"
 #include "Simulation.h"
 #include "Body.h"  // Add this include
+#include "BodyStore.h"
+#include "SimulationRunner.h"
+#include "BodyRenderer.h"
+#include "Profiler.h"
+#include "Checkpoint.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -20,6 +25,26 @@ unsigned int FPS::getFPS() const {
     return mFps;
 }
 
+void printForceSolver(const Simulation& simulation) {
+    if (simulation.getForceMethod() == ForceMethod::Direct) {
+        std::cout << "Force solver: direct sum" << std::endl;
+        return;
+    }
+
+    if (simulation.getForceMethod() == ForceMethod::BarnesHut) {
+        std::cout << "Force solver: Barnes-Hut (theta " << simulation.getTheta() << ")";
+    } else {
+        const ParticleMesh::Settings& mesh = simulation.getMeshSettings();
+        std::cout << "Force solver: particle-mesh (" << mesh.gridSize << "^2 grid, "
+                  << (mesh.assignment == MassAssignment::TSC ? "TSC" : "CIC")
+                  << (mesh.shortRange ? ", P3M" : "") << ")";
+    }
+
+    ForceError error = simulation.measureForceError();
+    std::cout << ", relative error vs direct sum over " << error.samples << " bodies: "
+              << "rms " << error.rmsRelative << ", max " << error.maxRelative << std::endl;
+}
+
 // UIManager implementation
 UIManager::UIManager(unsigned int windowWidth, unsigned int windowHeight) : hideTui(false) {
     // Initialize text objects with positions
@@ -41,12 +66,16 @@ UIManager::UIManager(unsigned int windowWidth, unsigned int windowHeight) : hide
 
     controlsText.setCharacterSize(12);
     controlsText.setFillColor(sf::Color::White);
-    controlsText.setPosition(10, windowHeight - 156);
-    controlsText.setString("Mouse Right-click + drag to pan\nScroll to zoom\nSpace to hide interface\nR to reset with random bodies\nT to toggle trails\nF to increase time step\nS to decrease time step\n+ to add 100 more bodies\n- to remove 100 bodies\nH to increase softening\nK to decrease softening\nESC to exit");
+    controlsText.setPosition(10, windowHeight - 245);
+    controlsText.setString("Mouse Right-click + drag to pan\nScroll to zoom\nSpace to hide interface\nR to reset with the next seed\nT to toggle trails\nB to cycle force solver\nP to cycle backend\nI to cycle integrator\nE to print total energy\nF5 to save a checkpoint\nF9 to load it\nF to increase time step\nS to decrease time step\n+ to add 100 more bodies\n- to remove 100 bodies\nH to increase softening\nK to decrease softening\nESC to exit");
 
     fpsText.setCharacterSize(12);
     fpsText.setFillColor(sf::Color::White);
-    fpsText.setPosition(windowWidth - 80, 10);
+    fpsText.setPosition(windowWidth - 110, 10);
+
+    stepRateText.setCharacterSize(12);
+    stepRateText.setFillColor(sf::Color::White);
+    stepRateText.setPosition(windowWidth - 110, 30);
 }
 
 bool UIManager::loadFont(const std::string& fontPath) {
@@ -62,10 +91,12 @@ bool UIManager::loadFont(const std::string& fontPath) {
     trailText.setFont(font);
     controlsText.setFont(font);
     fpsText.setFont(font);
+    stepRateText.setFont(font);
     return true;
 }
 
-void UIManager::updateTexts(int numBodies, float dt, float softening, bool showTrails, unsigned int currentFPS) {
+void UIManager::updateTexts(int numBodies, float dt, float softening, bool showTrails,
+                            unsigned int currentFPS, double stepsPerSecond) {
     bodyCountText.setString("Bodies: " + std::to_string(numBodies));
     
     std::stringstream ts;
@@ -78,6 +109,10 @@ void UIManager::updateTexts(int numBodies, float dt, float softening, bool showT
     
     trailText.setString(showTrails ? "Trails: ON" : "");
     fpsText.setString("FPS: " + std::to_string(currentFPS));
+
+    std::stringstream sps;
+    sps << std::fixed << std::setprecision(0) << stepsPerSecond;
+    stepRateText.setString("Steps/s: " + sps.str());
 }
 
 void UIManager::draw(sf::RenderWindow& window) {
@@ -88,6 +123,7 @@ void UIManager::draw(sf::RenderWindow& window) {
         window.draw(trailText);
         window.draw(controlsText);
         window.draw(fpsText);
+        window.draw(stepRateText);
     }
 }
 
@@ -98,7 +134,7 @@ InputHandler::InputHandler(bool& trails, int& bodies, float& timeStep, float& so
       G(gravConst), windowWidth(winWidth), windowHeight(winHeight) {}
 
 bool InputHandler::handleEvent(const sf::Event& event, sf::RenderWindow& window,
-                              Simulation& simulation, TrailManager& trailManager,
+                              SimulationRunner& runner, TrailManager& trailManager,
                               UIManager& uiManager, sf::View& view, float& zoomLevel) {
     
     if (event.type == sf::Event::Closed) {
@@ -173,11 +209,54 @@ bool InputHandler::handleEvent(const sf::Event& event, sf::RenderWindow& window,
     }
     
     if (event.type == sf::Event::KeyPressed) {
+        // Simulation changes are posted to the simulation thread and applied
+        // between two steps
         auto resetSimulation = [&]() {
-            simulation = Simulation(G, softening, dt, windowWidth, windowHeight);
-            simulation.initializeRandomBodies(numBodies, 100.0f, 8000.0f);
+            const int bodies = numBodies;
+            const float g = G, soft = softening, timeStep = dt;
+            const float w = static_cast<float>(windowWidth), h = static_cast<float>(windowHeight);
+            runner.post([=](Simulation& simulation) {
+                ForceMethod method = simulation.getForceMethod();
+                float theta = simulation.getTheta();
+                DirectSumMode directMode = simulation.getDirectSumMode();
+                KernelTiles tiles = simulation.getKernelTiles();
+                ParticleMesh::Settings meshSettings = simulation.getMeshSettings();
+                Integrator integrator = simulation.getIntegrator();
+                BlockStepSettings blockSteps = simulation.getBlockStepSettings();
+                ReorderSettings reorder = simulation.getReorderSettings();
+                AffinityMode affinity = simulation.getAffinity();
+                std::string backend = simulation.getBackend().name();
+                TrajectoryWriter* trajectory = simulation.getTrajectoryWriter();
+                InitialConditions conditions = simulation.getInitialConditions();
+                conditions.seed++;
+                std::cout << "Reset with " << distributionName(conditions.distribution) << " bodies, seed "
+                          << conditions.seed << std::endl;
+                simulation = Simulation(g, soft, timeStep, w, h);
+                simulation.setBackend(backend);
+                simulation.setForceMethod(method);
+                simulation.setTheta(theta);
+                simulation.setDirectSumMode(directMode);
+                simulation.setKernelTiles(tiles);
+                simulation.setMeshSettings(meshSettings);
+                simulation.setIntegrator(integrator);
+                simulation.setBlockStepSettings(blockSteps);
+                simulation.setReorderSettings(reorder);
+                simulation.setAffinity(affinity);
+                simulation.setTrajectoryWriter(trajectory);
+                simulation.initializeBodies(bodies, conditions);
+            });
             trailManager.clear();
         };
+
+        // dt and softening change on the running system, which keeps its
+        // evolved state and trails
+        auto setParameters = [&]() {
+            const float timeStep = dt, soft = softening;
+            runner.post([=](Simulation& simulation) {
+                simulation.setTimeStep(timeStep);
+                simulation.setSoftening(soft);
+            });
+        };
         
         switch (event.key.code) {
             case sf::Keyboard::Escape:
@@ -191,23 +270,23 @@ bool InputHandler::handleEvent(const sf::Event& event, sf::RenderWindow& window,
             case sf::Keyboard::F:
                 dt *= 10;
                 if (dt >= 0.001f) softening += 1.0f;
-                resetSimulation();
+                setParameters();
                 break;
 
             case sf::Keyboard::S:
                 dt /= 10;
                 if (softening > 1.0f) softening -= 1.0f;
-                resetSimulation();
+                setParameters();
                 break;
 
             case sf::Keyboard::H:
                 softening += 1.0f;
-                resetSimulation();
+                setParameters();
                 break;
 
             case sf::Keyboard::K:
                 if (softening > 1.0f) softening -= 1.0f;
-                resetSimulation();
+                setParameters();
                 break;
 
             case sf::Keyboard::R:
@@ -216,20 +295,133 @@ bool InputHandler::handleEvent(const sf::Event& event, sf::RenderWindow& window,
 
             case sf::Keyboard::Add:
             case sf::Keyboard::Equal:
+                // Into the running system, which keeps its evolved state and trails
                 numBodies += 100;
-                resetSimulation();
+                runner.post([](Simulation& simulation) { simulation.addBodies(100); });
                 break;
                 
             case sf::Keyboard::Subtract:
             case sf::Keyboard::Dash:
+                // The newest bodies go first, the initial central masses last
                 numBodies = std::max(11, numBodies - 100);
-                resetSimulation();
+                runner.post([](Simulation& simulation) {
+                    const size_t n = simulation.getStore().size();
+                    simulation.removeNewestBodies(n > 11 ? std::min<size_t>(100, n - 11) : 0);
+                });
                 break;
                 
             case sf::Keyboard::T:
                 trailManager.toggle();
                 showTrails = trailManager.isEnabled();
                 break;
+
+            case sf::Keyboard::B:
+                // Cycle solvers on the live state, no reset needed
+                runner.post([](Simulation& simulation) {
+                    switch (simulation.getForceMethod()) {
+                        case ForceMethod::Direct:
+                            simulation.setForceMethod(ForceMethod::BarnesHut);
+                            break;
+                        case ForceMethod::BarnesHut:
+                            simulation.setForceMethod(ForceMethod::ParticleMesh);
+                            break;
+                        case ForceMethod::ParticleMesh:
+                            simulation.setForceMethod(ForceMethod::Direct);
+                            break;
+                    }
+                    printForceSolver(simulation);
+                });
+                break;
+
+            case sf::Keyboard::F5: {
+                if (!checkpointWriter) break;
+                CheckpointWriter* writer = checkpointWriter;
+                const std::string path = checkpointPath;
+                runner.post([writer, path](Simulation& simulation) {
+                    if (!simulation.saveCheckpoint(*writer, path)) {
+                        std::cout << "Previous checkpoint still being written, try again." << std::endl;
+                    }
+                });
+                break;
+            }
+
+            case sf::Keyboard::F9: {
+                if (!checkpointWriter) break;
+                // Read the header here for the values the interface shows,
+                // the bodies are loaded between two steps
+                MappedCheckpoint file;
+                std::string error;
+                if (!file.open(checkpointPath, error)) {
+                    std::cout << "Could not load checkpoint: " << error << "." << std::endl;
+                    break;
+                }
+                numBodies = static_cast<int>(file.bodyCount());
+                dt = file.header().parameters.timeStep;
+                softening = file.header().parameters.softening;
+
+                const std::string path = checkpointPath;
+                runner.post([path](Simulation& simulation) {
+                    std::string error;
+                    if (simulation.loadCheckpoint(path, error)) {
+                        std::cout << "Checkpoint loaded: " << simulation.getStore().size() << " bodies, step "
+                                  << simulation.getStepCount() << ", " << path << std::endl;
+                    } else {
+                        std::cout << "Could not load checkpoint: " << error << "." << std::endl;
+                    }
+                });
+                trailManager.clear();
+                break;
+            }
+
+            case sf::Keyboard::P:
+                // Cycle backends; the bodies carry over, so each one can be
+                // compared on the same state
+                runner.post([](Simulation& simulation) {
+                    const std::vector<std::string> names = forceSolverNames();
+                    auto current = std::find(names.begin(), names.end(), simulation.getBackend().name());
+                    if (current == names.end() || ++current == names.end()) current = names.begin();
+                    simulation.setBackend(*current);
+                    std::cout << "Backend: " << simulation.getBackend().name() << " ("
+                              << simulation.getThreadCount() << " thread(s))" << std::endl;
+                });
+                break;
+
+            case sf::Keyboard::I:
+                // Cycle integrators; the new one starts from the current state
+                runner.post([](Simulation& simulation) {
+                    Integrator next = Integrator::Euler;
+                    switch (simulation.getIntegrator()) {
+                        case Integrator::Euler: next = Integrator::Leapfrog; break;
+                        case Integrator::Leapfrog: next = Integrator::VelocityVerlet; break;
+                        case Integrator::VelocityVerlet: next = Integrator::Yoshida4; break;
+                        case Integrator::Yoshida4: next = Integrator::BlockLeapfrog; break;
+                        case Integrator::BlockLeapfrog: next = Integrator::Euler; break;
+                    }
+                    simulation.setIntegrator(next);
+                    std::cout << "Integrator: " << integratorName(next) << " ("
+                              << forceEvaluationsPerStep(next) << " force evaluation(s) per step)" << std::endl;
+                });
+                break;
+
+            case sf::Keyboard::E:
+                runner.post([](Simulation& simulation) {
+                    std::cout << "Total energy: " << simulation.totalEnergy() << std::endl;
+                    const size_t n = simulation.getStore().size();
+                    if (simulation.getStepCount() > 0 && n > 0) {
+                        std::cout << "Force evaluations per body and step: "
+                                  << static_cast<double>(simulation.getForceEvaluations()) /
+                                     (static_cast<double>(simulation.getStepCount()) * n) << std::endl;
+                    }
+                    if (simulation.getIntegrator() == Integrator::BlockLeapfrog) {
+                        const std::vector<size_t>& levels = simulation.getLevelCounts();
+                        std::cout << "Bodies per time-step level:";
+                        for (size_t level = 0; level < levels.size(); level++) {
+                            std::cout << " " << level << ":" << levels[level];
+                        }
+                        std::cout << std::endl;
+                    }
+                });
+                break;
         }
     }
     
@@ -249,22 +441,17 @@ void TrailManager::clear() {
     trailTexture.display();
 }
 
-void TrailManager::update(const std::vector<Body>& bodies) {
+void TrailManager::update(const BodyRenderer& renderer) {
     if (!showTrails) return;
+    PROFILE_SCOPE("trails");
     
     // Draw faded version of previous frame
     sf::RectangleShape fadeRect(sf::Vector2f(trailTexture.getSize().x, trailTexture.getSize().y));
     fadeRect.setFillColor(sf::Color(10, 10, 40, 10));
     trailTexture.draw(fadeRect);
     
-    // Draw all bodies to trail texture
-    for (const auto& body : bodies) {
-        sf::CircleShape circle(body.getRadius());
-        circle.setFillColor(body.getColor());
-        circle.setOrigin(body.getRadius(), body.getRadius());
-        circle.setPosition(body.getPosition());
-        trailTexture.draw(circle);
-    }
+    // Draw all bodies to trail texture in one batch
+    renderer.draw(trailTexture);
     
     trailTexture.display();
 }
@@ -0,0 +1,319 @@
+#include "ForceKernel.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NBODY_X86 1
+#endif
+
+namespace {
+
+using KernelFn = void (*)(const float*, const float*, size_t,
+                          const float*, const float*, const float*, size_t,
+                          float, float, float*, float*);
+
+struct KernelChoice {
+    KernelFn fn;
+    const char* name;
+    int width;
+};
+
+// Sum of the contributions of sources [begin, end) on one target, without G
+inline void scalarRow(float xi, float yi, const float* sx, const float* sy, const float* sm,
+                      size_t begin, size_t end, float eps2, float& accX, float& accY) {
+    for (size_t j = begin; j < end; j++) {
+        float dx = sx[j] - xi;
+        float dy = sy[j] - yi;
+        float distSquared = dx * dx + dy * dy + eps2;
+        float invDistance = 1.0f / std::sqrt(distSquared);
+        float scale = sm[j] * invDistance * invDistance * invDistance;
+        accX += dx * scale;
+        accY += dy * scale;
+    }
+}
+
+void kernelScalar(const float* tx, const float* ty, size_t nt,
+                  const float* sx, const float* sy, const float* sm, size_t ns,
+                  float G, float eps2, float* ax, float* ay) {
+    for (size_t i = 0; i < nt; i++) {
+        float accX = 0.0f, accY = 0.0f;
+        scalarRow(tx[i], ty[i], sx, sy, sm, 0, ns, eps2, accX, accY);
+        ax[i] += G * accX;
+        ay[i] += G * accY;
+    }
+}
+
+#ifdef NBODY_X86
+
+// 4 interactions per iteration; SSE2 is part of the x86-64 baseline
+void kernelSSE(const float* tx, const float* ty, size_t nt,
+               const float* sx, const float* sy, const float* sm, size_t ns,
+               float G, float eps2, float* ax, float* ay) {
+    const __m128 eps = _mm_set1_ps(eps2);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const size_t vecEnd = ns & ~size_t(3);
+
+    for (size_t i = 0; i < nt; i++) {
+        const __m128 xi = _mm_set1_ps(tx[i]);
+        const __m128 yi = _mm_set1_ps(ty[i]);
+        __m128 accX = _mm_setzero_ps();
+        __m128 accY = _mm_setzero_ps();
+
+        for (size_t j = 0; j < vecEnd; j += 4) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(sx + j), xi);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(sy + j), yi);
+            __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), eps);
+
+            // Fast 1/sqrt plus one Newton step: r = r * (1.5 - 0.5 * r2 * r^2)
+            __m128 r = _mm_rsqrt_ps(r2);
+            r = _mm_mul_ps(r, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, r2), _mm_mul_ps(r, r))));
+
+            __m128 scale = _mm_mul_ps(_mm_loadu_ps(sm + j), _mm_mul_ps(r, _mm_mul_ps(r, r)));
+            accX = _mm_add_ps(accX, _mm_mul_ps(dx, scale));
+            accY = _mm_add_ps(accY, _mm_mul_ps(dy, scale));
+        }
+
+        float lanesX[4], lanesY[4];
+        _mm_storeu_ps(lanesX, accX);
+        _mm_storeu_ps(lanesY, accY);
+        float sumX = (lanesX[0] + lanesX[1]) + (lanesX[2] + lanesX[3]);
+        float sumY = (lanesY[0] + lanesY[1]) + (lanesY[2] + lanesY[3]);
+        scalarRow(tx[i], ty[i], sx, sy, sm, vecEnd, ns, eps2, sumX, sumY);
+
+        ax[i] += G * sumX;
+        ay[i] += G * sumY;
+    }
+}
+
+// 8 interactions per iteration
+__attribute__((target("avx2,fma")))
+void kernelAVX2(const float* tx, const float* ty, size_t nt,
+                const float* sx, const float* sy, const float* sm, size_t ns,
+                float G, float eps2, float* ax, float* ay) {
+    const __m256 eps = _mm256_set1_ps(eps2);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const size_t vecEnd = ns & ~size_t(7);
+
+    for (size_t i = 0; i < nt; i++) {
+        const __m256 xi = _mm256_set1_ps(tx[i]);
+        const __m256 yi = _mm256_set1_ps(ty[i]);
+        __m256 accX = _mm256_setzero_ps();
+        __m256 accY = _mm256_setzero_ps();
+
+        for (size_t j = 0; j < vecEnd; j += 8) {
+            __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(sx + j), xi);
+            __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(sy + j), yi);
+            __m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, eps));
+
+            __m256 r = _mm256_rsqrt_ps(r2);
+            r = _mm256_mul_ps(r, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(r, r), threeHalves));
+
+            __m256 scale = _mm256_mul_ps(_mm256_loadu_ps(sm + j), _mm256_mul_ps(r, _mm256_mul_ps(r, r)));
+            accX = _mm256_fmadd_ps(dx, scale, accX);
+            accY = _mm256_fmadd_ps(dy, scale, accY);
+        }
+
+        __m128 sx4 = _mm_add_ps(_mm256_castps256_ps128(accX), _mm256_extractf128_ps(accX, 1));
+        __m128 sy4 = _mm_add_ps(_mm256_castps256_ps128(accY), _mm256_extractf128_ps(accY, 1));
+        float lanesX[4], lanesY[4];
+        _mm_storeu_ps(lanesX, sx4);
+        _mm_storeu_ps(lanesY, sy4);
+        float sumX = (lanesX[0] + lanesX[1]) + (lanesX[2] + lanesX[3]);
+        float sumY = (lanesY[0] + lanesY[1]) + (lanesY[2] + lanesY[3]);
+        scalarRow(tx[i], ty[i], sx, sy, sm, vecEnd, ns, eps2, sumX, sumY);
+
+        ax[i] += G * sumX;
+        ay[i] += G * sumY;
+    }
+}
+
+// 16 interactions per iteration; the tail uses masked loads with zero mass
+__attribute__((target("avx512f")))
+void kernelAVX512(const float* tx, const float* ty, size_t nt,
+                  const float* sx, const float* sy, const float* sm, size_t ns,
+                  float G, float eps2, float* ax, float* ay) {
+    const __m512 eps = _mm512_set1_ps(eps2);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+    const size_t vecEnd = ns & ~size_t(15);
+    const __mmask16 tailMask = static_cast<__mmask16>((1u << (ns - vecEnd)) - 1u);
+
+    for (size_t i = 0; i < nt; i++) {
+        const __m512 xi = _mm512_set1_ps(tx[i]);
+        const __m512 yi = _mm512_set1_ps(ty[i]);
+        __m512 accX = _mm512_setzero_ps();
+        __m512 accY = _mm512_setzero_ps();
+
+        for (size_t j = 0; j <= vecEnd && j < ns; j += 16) {
+            const __mmask16 mask = (j < vecEnd) ? static_cast<__mmask16>(0xFFFF) : tailMask;
+            __m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, sx + j), xi);
+            __m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, sy + j), yi);
+            __m512 r2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, eps));
+
+            __m512 r = _mm512_maskz_rsqrt14_ps(static_cast<__mmask16>(0xFFFF), r2);
+            r = _mm512_mul_ps(r, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(r, r), threeHalves));
+
+            // Masked-off lanes load zero mass and contribute nothing
+            __m512 scale = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, sm + j), _mm512_mul_ps(r, _mm512_mul_ps(r, r)));
+            accX = _mm512_fmadd_ps(dx, scale, accX);
+            accY = _mm512_fmadd_ps(dy, scale, accY);
+        }
+
+        alignas(64) float lanesX[16], lanesY[16];
+        _mm512_store_ps(lanesX, accX);
+        _mm512_store_ps(lanesY, accY);
+        float sumX = 0.0f, sumY = 0.0f;
+        for (int l = 0; l < 16; l++) {
+            sumX += lanesX[l];
+            sumY += lanesY[l];
+        }
+
+        ax[i] += G * sumX;
+        ay[i] += G * sumY;
+    }
+}
+
+#endif // NBODY_X86
+
+KernelChoice selectKernel() {
+    const KernelChoice scalar{kernelScalar, "scalar", 1};
+#ifdef NBODY_X86
+    const KernelChoice sse{kernelSSE, "SSE", 4};
+    const KernelChoice avx2{kernelAVX2, "AVX2", 8};
+    const KernelChoice avx512{kernelAVX512, "AVX-512", 16};
+
+    __builtin_cpu_init();
+    const bool hasAVX512 = __builtin_cpu_supports("avx512f");
+    const bool hasAVX2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+    const char* forced = std::getenv("NBODY_KERNEL");
+    if (forced && *forced) {
+        if (std::strcmp(forced, "scalar") == 0) return scalar;
+        if (std::strcmp(forced, "sse") == 0) return sse;
+        if (std::strcmp(forced, "avx2") == 0 && hasAVX2) return avx2;
+        if (std::strcmp(forced, "avx512") == 0 && hasAVX512) return avx512;
+        std::cerr << "Warning: NBODY_KERNEL=" << forced
+                  << " is not available on this CPU, choosing automatically." << std::endl;
+    }
+
+    if (hasAVX512) return avx512;
+    if (hasAVX2) return avx2;
+    return sse;
+#else
+    return scalar;
+#endif
+}
+
+const KernelChoice& activeKernel() {
+    static const KernelChoice choice = selectKernel();
+    return choice;
+}
+
+} // namespace
+
+void accumulateAccelerations(const float* targetX, const float* targetY, size_t targetCount,
+                             const float* sourceX, const float* sourceY, const float* sourceMass,
+                             size_t sourceCount, float G, float eps2,
+                             float* ax, float* ay) {
+    activeKernel().fn(targetX, targetY, targetCount, sourceX, sourceY, sourceMass,
+                      sourceCount, G, eps2, ax, ay);
+}
+
+const char* forceKernelName() {
+    return activeKernel().name;
+}
+
+int forceKernelWidth() {
+    return activeKernel().width;
+}
+
+KernelTiles defaultKernelTiles() {
+    long l1 = -1, l2 = -1;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    // Conservative guesses when the OS does not report cache sizes
+    if (l1 <= 0) l1 = 32 * 1024;
+    if (l2 <= 0) l2 = 256 * 1024;
+
+    // Use half of each level, leaving room for everything else in flight:
+    // 12 bytes per source (x, y, mass), 16 per target (x, y, ax, ay)
+    size_t sources = static_cast<size_t>(l1) / 2 / 12;
+    size_t targets = static_cast<size_t>(l2) / 2 / 16;
+
+    // Round down to a multiple of 64 so blocks stay vector- and line-aligned
+    sources = std::max<size_t>(64, sources & ~size_t(63));
+    targets = std::max<size_t>(64, targets & ~size_t(63));
+    return KernelTiles{targets, sources};
+}
+
+KernelTiles resolveKernelTiles(KernelTiles tiles) {
+    static const KernelTiles defaults = defaultKernelTiles();
+    if (tiles.targetBlock == 0) tiles.targetBlock = defaults.targetBlock;
+    if (tiles.sourceBlock == 0) tiles.sourceBlock = defaults.sourceBlock;
+    return tiles;
+}
+
+void accumulateAccelerationsBlocked(const float* targetX, const float* targetY, size_t targetCount,
+                                    const float* sourceX, const float* sourceY, const float* sourceMass,
+                                    size_t sourceCount, float G, float eps2,
+                                    float* ax, float* ay, const KernelTiles& tiles) {
+    const KernelTiles t = resolveKernelTiles(tiles);
+    const KernelFn fn = activeKernel().fn;
+
+    for (size_t ib = 0; ib < targetCount; ib += t.targetBlock) {
+        const size_t ic = std::min(t.targetBlock, targetCount - ib);
+        for (size_t jb = 0; jb < sourceCount; jb += t.sourceBlock) {
+            const size_t jc = std::min(t.sourceBlock, sourceCount - jb);
+            fn(targetX + ib, targetY + ib, ic,
+               sourceX + jb, sourceY + jb, sourceMass + jb, jc,
+               G, eps2, ax + ib, ay + ib);
+        }
+    }
+}
+
+ForceError compareWithDirectSum(const float* x, const float* y, const float* mass, size_t n,
+                                const float* ax, const float* ay, float G, float eps2, int samples) {
+    ForceError error{0.0f, 0.0f, 0};
+    if (n < 2 || samples <= 0) return error;
+
+    const size_t stride = std::max<size_t>(1, n / static_cast<size_t>(samples));
+    double sumSquared = 0.0;
+
+    for (size_t i = 0; i < n && error.samples < samples; i += stride) {
+        double refX = 0.0, refY = 0.0;
+        for (size_t j = 0; j < n; j++) {
+            if (j == i) continue;
+            double dx = x[j] - x[i];
+            double dy = y[j] - y[i];
+            double distSquared = dx * dx + dy * dy + eps2;
+            double scale = G * mass[j] / (distSquared * std::sqrt(distSquared));
+            refX += dx * scale;
+            refY += dy * scale;
+        }
+
+        double reference = std::sqrt(refX * refX + refY * refY);
+        if (reference <= 0.0) continue;
+
+        double ex = ax[i] - refX;
+        double ey = ay[i] - refY;
+        double relative = std::sqrt(ex * ex + ey * ey) / reference;
+
+        sumSquared += relative * relative;
+        error.maxRelative = std::max(error.maxRelative, static_cast<float>(relative));
+        error.samples++;
+    }
+
+    if (error.samples > 0) {
+        error.rmsRelative = static_cast<float>(std::sqrt(sumSquared / error.samples));
+    }
+    return error;
+}
@@ -0,0 +1,73 @@
+#include "ForceSolver.h"
+#include <algorithm>
+#include <map>
+#include <omp.h>
+
+namespace {
+
+// Filled by static initializers in the backend files, so it must exist
+// before the first of them runs
+std::map<std::string, ForceSolverFactory>& registry() {
+    static std::map<std::string, ForceSolverFactory> factories;
+    return factories;
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+bool registerForceSolver(const char* name, ForceSolverFactory factory) {
+    registry()[name] = factory;
+    return true;
+}
+
+std::string resolveForceSolverName(const std::string& name) {
+    const std::string resolved = (name == "omp") ? std::string("openmp") : name;
+    return registry().count(resolved) ? resolved : std::string();
+}
+
+std::unique_ptr<ForceSolver> createForceSolver(const std::string& name) {
+    const std::string resolved = resolveForceSolverName(name);
+    if (resolved.empty()) return nullptr;
+    return registry()[resolved]();
+}
+
+std::vector<std::string> forceSolverNames() {
+    std::vector<std::string> names;
+    for (const auto& entry : registry()) names.push_back(entry.first);
+    return names;
+}
+
+const char* defaultForceSolver() {
+    return "openmp";
+}
+
+std::string forceSolverForProgram(const std::string& programName) {
+    const std::string base = programName.substr(programName.find_last_of('/') + 1);
+    if (endsWith(base, "_serial")) return "serial";
+    if (endsWith(base, "_omp")) return "openmp";
+    if (endsWith(base, "_pool")) return "pool";
+    return defaultForceSolver();
+}
+
+void directAccelerations(const ForceRequest& request) {
+    BodyStore& bodies = request.bodies;
+    const size_t n = bodies.size();
+    std::fill(bodies.ax.begin(), bodies.ax.end(), 0.0f);
+    std::fill(bodies.ay.begin(), bodies.ay.end(), 0.0f);
+    accumulateAccelerationsBlocked(bodies.x.data(), bodies.y.data(), n, bodies.x.data(), bodies.y.data(),
+                                   bodies.mass.data(), n, request.gravitationalConstant,
+                                   request.softening * request.softening,
+                                   bodies.ax.data(), bodies.ay.data(), request.kernelTiles);
+}
+
+void meshAccelerations(const ForceRequest& request, int threads) {
+    const int previous = omp_get_max_threads();
+    omp_set_num_threads(std::max(1, threads));
+    request.mesh.computeAccelerations(request.bodies, request.gravitationalConstant, request.softening,
+                                      request.bodies.ax.data(), request.bodies.ay.data());
+    omp_set_num_threads(previous);
+}
@@ -0,0 +1,292 @@
+#include "InitialConditions.h"
+#include "ForceSolver.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const float PI = 3.14159265358979f;
+const float CENTRAL_MASS = 50000.0f;
+
+// SplitMix64 finalizer, a bijection that scrambles every input bit
+uint64_t mix(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Counter-based random stream of one body: draw k is a hash of the key and
+// k, so no state is shared between bodies or carried from one to the next
+class BodyStream {
+public:
+    BodyStream(uint64_t seed, uint64_t body) : key(mix(mix(seed) + body)), counter(0) {}
+
+    // Uniform in [0, 1) with the 24 bits a float holds
+    float uniform() {
+        return static_cast<float>(mix(key ^ (counter++ * 0xd1b54a32d192ed03ull)) >> 40) * (1.0f / 16777216.0f);
+    }
+
+    float uniform(float low, float high) { return low + (high - low) * uniform(); }
+
+    int uniformInt(int low, int high) {
+        return std::min(high, low + static_cast<int>(uniform() * (high - low + 1)));
+    }
+
+private:
+    uint64_t key;
+    uint64_t counter;
+};
+
+struct GeneratedBody {
+    float x, y, vx, vy;
+    float mass;
+    float radius;
+    sf::Color color;
+};
+
+// Everything a body needs besides its index
+struct Context {
+    InitialConditions conditions;
+    size_t n;                  // Bodies asked for
+    size_t heavy;              // Disk: heavy bodies after the central one
+    float G;
+    float width, height;
+};
+
+GeneratedBody central(float x, float y) {
+    return GeneratedBody{x, y, 0.0f, 0.0f, CENTRAL_MASS, 10.0f, sf::Color(255, 255, 255)};
+}
+
+// Body at the given distance and angle around a central mass, moving
+// perpendicular to the radius at orbitFactor times the circular speed
+GeneratedBody orbiting(const Context& context, float cx, float cy, float angle, float distance,
+                       float orbitFactor) {
+    const float speed = std::sqrt(context.G * CENTRAL_MASS / distance) * orbitFactor;
+    const float c = std::cos(angle);
+    const float s = std::sin(angle);
+    GeneratedBody body;
+    body.x = cx + distance * c;
+    body.y = cy + distance * s;
+    body.vx = -speed * s;
+    body.vy = speed * c;
+    return body;
+}
+
+// The original random disk: central mass first, then the heavy bodies, then n - 1 light ones
+GeneratedBody diskBody(const Context& context, size_t i, BodyStream& random) {
+    const float cx = context.width / 2;
+    const float cy = context.height / 2;
+    const float outer = std::min(context.width, context.height) / 2 - 50.0f;
+    if (i == 0) return central(cx, cy);
+
+    const bool heavy = i <= context.heavy;
+    const float angle = random.uniform(0.0f, 2.0f * PI);
+    const float distance = random.uniform(heavy ? 250.0f : 50.0f, outer);
+    const float orbitFactor = random.uniform(0.7f, 1.0f);
+    GeneratedBody body = orbiting(context, cx, cy, angle, distance, orbitFactor);
+
+    if (heavy) {
+        body.mass = random.uniform(1000.0f, context.conditions.maxMassBig);
+        body.radius = random.uniform(4.0f, 9.0f);
+        body.color = sf::Color(255, 255, 255);
+    } else {
+        body.mass = random.uniform(20.0f, context.conditions.maxMassSmall);
+        body.radius = random.uniform(0.5f, 1.5f);
+        const int r = random.uniformInt(50, 255);
+        const int g = random.uniformInt(50, 255);
+        body.color = sf::Color(r, g, random.uniformInt(50, 255));
+    }
+    return body;
+}
+
+// Plummer sphere of scale radius a, projected onto the plane. Radii invert
+// the cumulative mass M(r) = r^3 / (r^2 + a^2)^(3/2); speeds are drawn by
+// rejection from the distribution function (Aarseth, Henon & Wielen 1974).
+GeneratedBody plummerBody(const Context& context, BodyStream& random) {
+    const float a = std::min(context.width, context.height) / 10.0f;
+    const float totalMass = context.n * 0.5f * (20.0f + context.conditions.maxMassSmall);
+    const int maxTries = 64;
+
+    // Cut the tail at 10a, where a few bodies would otherwise end up far away
+    float r = 10.0f * a;
+    for (int t = 0; t < maxTries && r >= 10.0f * a; t++) {
+        const float u = random.uniform(1e-6f, 1.0f);
+        r = a / std::sqrt(std::pow(u, -2.0f / 3.0f) - 1.0f);
+    }
+
+    float q = 0.0f;
+    for (int t = 0; t < maxTries; t++) {
+        q = random.uniform();
+        const float g = random.uniform(0.0f, 0.1f);
+        if (g < q * q * std::pow(1.0f - q * q, 3.5f)) break;
+    }
+    const float escape = std::sqrt(2.0f * context.G * totalMass / a) * std::pow(1.0f + r * r / (a * a), -0.25f);
+    const float speed = q * escape;
+
+    // Isotropic directions in 3D, keeping x and y
+    auto direction = [&](float length, float& dx, float& dy) {
+        const float cosTheta = random.uniform(-1.0f, 1.0f);
+        const float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+        const float phi = random.uniform(0.0f, 2.0f * PI);
+        dx = length * sinTheta * std::cos(phi);
+        dy = length * sinTheta * std::sin(phi);
+    };
+
+    GeneratedBody body;
+    direction(r, body.x, body.y);
+    direction(speed, body.vx, body.vy);
+    body.x += context.width / 2;
+    body.y += context.height / 2;
+    body.mass = random.uniform(20.0f, context.conditions.maxMassSmall);
+    body.radius = random.uniform(0.5f, 1.5f);
+    const int level = random.uniformInt(150, 255);
+    body.color = sf::Color(level, level, 255);
+    return body;
+}
+
+// At rest anywhere in the world, a cold collapse
+GeneratedBody uniformBody(const Context& context, BodyStream& random) {
+    GeneratedBody body;
+    body.x = random.uniform(0.0f, context.width);
+    body.y = random.uniform(0.0f, context.height);
+    body.vx = 0.0f;
+    body.vy = 0.0f;
+    body.mass = random.uniform(20.0f, context.conditions.maxMassSmall);
+    body.radius = random.uniform(0.5f, 1.5f);
+    const int r = random.uniformInt(50, 255);
+    const int g = random.uniformInt(50, 255);
+    body.color = sf::Color(r, g, random.uniformInt(50, 255));
+    return body;
+}
+
+// Two disks spinning in opposite senses, half of the bodies each, each
+// starting with its central mass. They approach at half the speed of a
+// parabolic encounter, offset vertically so they pass before merging.
+// Bodies added later alternate between the two.
+GeneratedBody galaxyBody(const Context& context, size_t i, BodyStream& random) {
+    const size_t half = context.n / 2;
+    const int galaxy = i < context.n ? (i < half ? 0 : 1) : static_cast<int>(i & 1);
+    const size_t local = i < context.n ? (galaxy == 0 ? i : i - half) : i;
+    const float side = galaxy == 0 ? -1.0f : 1.0f;
+
+    const float cx = context.width / 2 + side * context.width / 5;
+    const float cy = context.height / 2 + side * context.height / 10;
+    const float separation = std::sqrt(std::pow(2 * context.width / 5, 2) + std::pow(2 * context.height / 10, 2));
+    const float approach = -side * 0.5f * std::sqrt(2.0f * context.G * 2.0f * CENTRAL_MASS / separation);
+
+    GeneratedBody body;
+    if (local == 0) {
+        body = central(cx, cy);
+    } else {
+        const float angle = random.uniform(0.0f, 2.0f * PI);
+        const float distance = random.uniform(20.0f, std::min(context.width, context.height) / 5);
+        body = orbiting(context, cx, cy, angle, distance, -side * random.uniform(0.95f, 1.0f));
+        body.mass = random.uniform(20.0f, context.conditions.maxMassSmall);
+        body.radius = random.uniform(0.5f, 1.5f);
+        const int level = random.uniformInt(50, 200);
+        body.color = galaxy == 0 ? sf::Color(255, level, level / 2) : sf::Color(level / 2, level, 255);
+    }
+    body.vx += approach;
+    return body;
+}
+
+Context makeContext(const InitialConditions& conditions, int n, float gravitationalConstant,
+                    float width, float height) {
+    Context context;
+    context.conditions = conditions;
+    context.n = static_cast<size_t>(std::max(0, n));
+    context.heavy = context.n / 50;
+    context.G = gravitationalConstant;
+    context.width = width;
+    context.height = height;
+    return context;
+}
+
+GeneratedBody makeBody(const Context& context, size_t i) {
+    BodyStream random(context.conditions.seed, i);
+    switch (context.conditions.distribution) {
+        case Distribution::Disk: return diskBody(context, i, random);
+        case Distribution::Plummer: return plummerBody(context, random);
+        case Distribution::Uniform: return uniformBody(context, random);
+        case Distribution::Galaxies: return galaxyBody(context, i, random);
+    }
+    return uniformBody(context, random);
+}
+
+} // namespace
+
+const char* distributionName(Distribution distribution) {
+    switch (distribution) {
+        case Distribution::Disk: return "disk";
+        case Distribution::Plummer: return "plummer";
+        case Distribution::Uniform: return "uniform";
+        case Distribution::Galaxies: return "galaxies";
+    }
+    return "unknown";
+}
+
+bool parseDistribution(const std::string& name, Distribution& distribution) {
+    if (name == "disk") {
+        distribution = Distribution::Disk;
+    } else if (name == "plummer") {
+        distribution = Distribution::Plummer;
+    } else if (name == "uniform") {
+        distribution = Distribution::Uniform;
+    } else if (name == "galaxies" || name == "collision") {
+        distribution = Distribution::Galaxies;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::size_t generatedBodyCount(const InitialConditions& conditions, int n) {
+    const size_t count = static_cast<size_t>(std::max(0, n));
+    return conditions.distribution == Distribution::Disk ? count + count / 50 : count;
+}
+
+void generateBodies(const InitialConditions& conditions, int n, float gravitationalConstant,
+                    float width, float height, BodyStore& bodies, ForceSolver& solver) {
+    PROFILE_SCOPE("generate bodies");
+    const Context context = makeContext(conditions, n, gravitationalConstant, width, height);
+
+    // Fresh arrays, so the writes below are their first touch. The room
+    // reserved for insertions is only address space until it is used.
+    const size_t count = generatedBodyCount(conditions, n);
+    bodies = BodyStore();
+    bodies.reserve(count + count / 8);
+    bodies.resize(count);
+
+    // One body per iteration through a call that is not vectorized across
+    // bodies, so the math is the same whichever thread a body lands on
+    solver.forEachRange(count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const GeneratedBody body = makeBody(context, i);
+            bodies.x[i] = body.x;
+            bodies.y[i] = body.y;
+            bodies.vx[i] = body.vx;
+            bodies.vy[i] = body.vy;
+            bodies.ax[i] = 0.0f;
+            bodies.ay[i] = 0.0f;
+            bodies.mass[i] = body.mass;
+            bodies.radius[i] = body.radius;
+            bodies.color[i] = body.color;
+            bodies.id[i] = static_cast<uint32_t>(i);
+        }
+    });
+    bodies.nextId = static_cast<uint32_t>(count);
+}
+
+void generateMoreBodies(const InitialConditions& conditions, int n, int count, float gravitationalConstant,
+                        float width, float height, BodyStore& batch, uint32_t firstId) {
+    const Context context = makeContext(conditions, n, gravitationalConstant, width, height);
+    batch.clear();
+    batch.reserve(static_cast<size_t>(std::max(0, count)));
+    for (int k = 0; k < count; k++) {
+        const GeneratedBody body = makeBody(context, firstId + static_cast<size_t>(k));
+        batch.emplace_back(sf::Vector2f(body.x, body.y), sf::Vector2f(body.vx, body.vy), body.mass,
+                           body.radius, body.color);
+    }
+}
@@ -0,0 +1,592 @@
+#include "Simulation.h"
+#include "Integrator.h"
+#include "Profiler.h"
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+
+const char* integratorName(Integrator integrator) {
+    switch (integrator) {
+        case Integrator::Euler: return "Euler";
+        case Integrator::Leapfrog: return "Leapfrog (KDK)";
+        case Integrator::VelocityVerlet: return "Velocity Verlet";
+        case Integrator::Yoshida4: return "Yoshida 4th order";
+        case Integrator::BlockLeapfrog: return "Block leapfrog";
+    }
+    return "Unknown";
+}
+
+bool parseIntegrator(const std::string& name, Integrator& integrator) {
+    if (name == "euler") {
+        integrator = Integrator::Euler;
+    } else if (name == "leapfrog" || name == "kdk") {
+        integrator = Integrator::Leapfrog;
+    } else if (name == "verlet" || name == "velocity-verlet") {
+        integrator = Integrator::VelocityVerlet;
+    } else if (name == "yoshida4" || name == "yoshida") {
+        integrator = Integrator::Yoshida4;
+    } else if (name == "block") {
+        integrator = Integrator::BlockLeapfrog;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int forceEvaluationsPerStep(Integrator integrator) {
+    return integrator == Integrator::Yoshida4 ? 3 : 1;
+}
+
+void Simulation::kick(float dt, size_t begin, size_t end) {
+    float* vx = bodies.vx.data();
+    float* vy = bodies.vy.data();
+    const float* ax = bodies.ax.data();
+    const float* ay = bodies.ay.data();
+
+    for (size_t i = begin; i < end; i++) {
+        vx[i] += ax[i] * dt;
+        vy[i] += ay[i] * dt;
+    }
+}
+
+void Simulation::kickDrift(float kickDt, float driftDt) {
+    PROFILE_SCOPE("kick-drift");
+    const size_t n = bodies.size();
+    float* x = bodies.x.data();
+    float* y = bodies.y.data();
+    float* vx = bodies.vx.data();
+    float* vy = bodies.vy.data();
+    const float* ax = bodies.ax.data();
+    const float* ay = bodies.ay.data();
+
+    // One pass instead of a kick and a drift loop
+    solver->forEachRange(n, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            vx[i] += ax[i] * kickDt;
+            vy[i] += ay[i] * kickDt;
+            x[i] += vx[i] * driftDt;
+            y[i] += vy[i] * driftDt;
+        }
+    });
+}
+
+void Simulation::evaluateAllForces(const BodyRangeFn& then) {
+    PROFILE_SCOPE("forces");
+    computeAccelerations(then);
+    forceEvaluations += bodies.size();
+}
+
+void Simulation::resynchronizeVelocities(float lag) {
+    if (velocityLag >= 0.0f && velocityLag != lag) {
+        // v(t - lag) = v(t - velocityLag) + a(t) (velocityLag - lag), with
+        // the accelerations the step would otherwise compute first
+        if (!accelerationsValid) evaluateAllForces();
+        accelerationsValid = true;
+        const float shift = velocityLag - lag;
+        solver->forEachRange(bodies.size(), [this, shift](size_t begin, size_t end) { kick(shift, begin, end); });
+    }
+    velocityLag = lag;
+}
+
+void Simulation::leapfrogStep(float dt) {
+    // The closing kick's accelerations are the next step's opening ones
+    if (!accelerationsValid) evaluateAllForces();
+    kickDrift(0.5f * dt, dt);
+
+    // Each body's closing kick runs as soon as its force is final
+    evaluateAllForces([this, dt](size_t begin, size_t end) { kick(0.5f * dt, begin, end); });
+    accelerationsValid = true;
+}
+
+void Simulation::reorderBodies() {
+    if (reorder.curve == SpaceFillingCurve::None || bodies.empty()) return;
+    PROFILE_SCOPE("reorder");
+    auto start = std::chrono::steady_clock::now();
+
+    // Accelerations move with their bodies, so they stay valid. The gathered
+    // arrays were written by one thread and are placed again on the next step.
+    spatialOrder(bodies.x.data(), bodies.y.data(), bodies.size(), reorder.curve, reorderOrder);
+    bodies.permute(reorderOrder);
+    if (stepLevel.size() == reorderOrder.size()) {
+        std::vector<uint8_t> permuted(stepLevel.size());
+        for (size_t i = 0; i < permuted.size(); i++) permuted[i] = stepLevel[reorderOrder[i]];
+        stepLevel.swap(permuted);
+    }
+    bodiesPlaced = false;
+    indexOfIdValid = false;
+
+    reorderCount++;
+    reorderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+namespace {
+
+// Copy into fresh pages written by the same static split the body loops use,
+// so on a NUMA machine each thread's slice lives on its own node
+template <typename T>
+void firstTouchCopy(ForceSolver& solver, AlignedVector<T>& values) {
+    const size_t n = values.size();
+    AlignedVector<T> placed;
+    placed.reserve(values.capacity());  // Keep the room for insertions
+    placed.resize(n);
+    const T* source = values.data();
+    T* target = placed.data();
+
+    solver.forEachRange(n, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            target[i] = source[i];
+        }
+    });
+    values.swap(placed);
+}
+
+} // namespace
+
+void Simulation::placeBodies() {
+    // A single thread touches everything wherever it goes
+    if (solver->threadCount() > 1) {
+        PROFILE_SCOPE("first touch");
+        firstTouchCopy(*solver, bodies.x);
+        firstTouchCopy(*solver, bodies.y);
+        firstTouchCopy(*solver, bodies.vx);
+        firstTouchCopy(*solver, bodies.vy);
+        firstTouchCopy(*solver, bodies.ax);
+        firstTouchCopy(*solver, bodies.ay);
+        firstTouchCopy(*solver, bodies.mass);
+    }
+    bodiesPlaced = true;
+}
+
+void Simulation::update() {
+    if (bodies.empty()) return;
+    PROFILE_SCOPE("step");
+
+    // Pin from the thread that steps the simulation: the OpenMP team used by
+    // the force loops belongs to it
+    if (affinity != AffinityMode::None && pinnedThreads != getThreadCount()) {
+        placement = pinThreads(*solver, affinity);
+        pinnedThreads = getThreadCount();
+        printPlacement(std::cout, affinity, placement);
+        bodiesPlaced = false;
+    }
+
+    if (reorder.interval > 0 && stepCount % reorder.interval == 0) {
+        reorderBodies();
+    }
+    if (!bodiesPlaced) placeBodies();
+
+    const float dt = timeStep;
+    const size_t n = bodies.size();
+    resynchronizeVelocities(integrator == Integrator::Euler ? 0.5f * dt : 0.0f);
+
+    switch (integrator) {
+        case Integrator::Euler: {
+            if (!accelerationsValid) evaluateAllForces();
+
+            float* x = bodies.x.data();
+            float* y = bodies.y.data();
+            float* vx = bodies.vx.data();
+            float* vy = bodies.vy.data();
+            const float* ax = bodies.ax.data();
+            const float* ay = bodies.ay.data();
+
+            // Velocity first, then position with the new velocity
+            PROFILE_SCOPE("integrate");
+            solver->forEachRange(n, [=](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    vx[i] += ax[i] * dt;
+                    vy[i] += ay[i] * dt;
+                    x[i] += vx[i] * dt;
+                    y[i] += vy[i] * dt;
+                }
+            });
+            accelerationsValid = false;
+            break;
+        }
+
+        case Integrator::Leapfrog:
+            leapfrogStep(dt);
+            break;
+
+        case Integrator::VelocityVerlet: {
+            if (!accelerationsValid) evaluateAllForces();
+            previousAx.resize(n);
+            previousAy.resize(n);
+
+            float* x = bodies.x.data();
+            float* y = bodies.y.data();
+            float* vx = bodies.vx.data();
+            float* vy = bodies.vy.data();
+            float* ax = bodies.ax.data();
+            float* ay = bodies.ay.data();
+            float* oldAx = previousAx.data();
+            float* oldAy = previousAy.data();
+            const float halfDt2 = 0.5f * dt * dt;
+
+            // x(t+dt) = x + v dt + a dt^2 / 2
+            {
+                PROFILE_SCOPE("drift");
+                solver->forEachRange(n, [=](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++) {
+                        x[i] += vx[i] * dt + ax[i] * halfDt2;
+                        y[i] += vy[i] * dt + ay[i] * halfDt2;
+                        oldAx[i] = ax[i];
+                        oldAy[i] = ay[i];
+                    }
+                });
+            }
+
+            // v(t+dt) = v + (a(t) + a(t+dt)) dt / 2, for each body as soon
+            // as its new force is final
+            evaluateAllForces([=](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    vx[i] += 0.5f * (oldAx[i] + ax[i]) * dt;
+                    vy[i] += 0.5f * (oldAy[i] + ay[i]) * dt;
+                }
+            });
+            accelerationsValid = true;
+            break;
+        }
+
+        case Integrator::Yoshida4: {
+            // Triple jump: w1, w0, w1 leapfrog substeps, the middle one backwards
+            static const double cbrt2 = std::cbrt(2.0);
+            static const float w1 = static_cast<float>(1.0 / (2.0 - cbrt2));
+            static const float w0 = static_cast<float>(-cbrt2 / (2.0 - cbrt2));
+            leapfrogStep(w1 * dt);
+            leapfrogStep(w0 * dt);
+            leapfrogStep(w1 * dt);
+            break;
+        }
+
+        case Integrator::BlockLeapfrog:
+            blockStep(dt);
+            break;
+    }
+    stepCount++;
+
+    if (trajectory && stepCount % trajectory->getSettings().interval == 0) {
+        recordTrajectory();
+    }
+}
+
+namespace {
+
+// Coarser levels are taken only once the criterion would allow them at half
+// the ideal step, so bodies near a threshold do not switch back and forth
+const float COARSEN_MARGIN = 2.0f;
+
+// Partners at least this much heavier than a body on a finer level, and
+// within this many softening lengths of it, share its step
+const float PARTNER_MASS_RATIO = 4.0f;
+const float PARTNER_RADIUS = 4.0f;
+
+// Cells per side of the grid the partners are looked up in
+const int MAX_PARTNER_CELLS = 512;
+
+int levelFor(float dt, float ideal, int maxLevel) {
+    int level = 0;
+    float step = dt;
+    while (step > ideal && level < maxLevel) {
+        step *= 0.5f;
+        level++;
+    }
+    return level;
+}
+
+} // namespace
+
+int Simulation::assignStepLevels(float dt) {
+    PROFILE_SCOPE("step levels");
+    const size_t n = bodies.size();
+    const float* x = bodies.x.data();
+    const float* y = bodies.y.data();
+    const float* vx = bodies.vx.data();
+    const float* vy = bodies.vy.data();
+    const float* ax = bodies.ax.data();
+    const float* ay = bodies.ay.data();
+    const float* mass = bodies.mass.data();
+    const float G = gravitationalConstant;
+    const float eps = std::max(softening, 1e-3f);
+    const float eta = blockSteps.accuracy;
+    const int maxLevel = std::min(std::max(blockSteps.maxLevel, 0), 20);
+
+    // Resolve the local dynamical time and never cross more than one
+    // softening length per step
+    idealStep.resize(n);
+    float* ideal = idealStep.data();
+    solver->forEachRange(n, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const float a = std::sqrt(ax[i] * ax[i] + ay[i] * ay[i]);
+            const float v = std::sqrt(vx[i] * vx[i] + vy[i] * vy[i]);
+            float step = dt;
+            if (a > 0.0f) step = std::min(step, eta * std::sqrt(eps / a));
+            if (v > 0.0f) step = std::min(step, eps / v);
+            ideal[i] = step;
+        }
+    });
+
+    // A light body passing a heavy one gets a fine level from the heavy
+    // one's pull, while the heavy one barely feels the light one and keeps
+    // its coarse step. Its side of the encounter is then sampled too rarely,
+    // and the missing reaction shows up as energy drift. Such partners take
+    // the step of the pair's relative acceleration, the same for both sides.
+    // Only close pairs matter, so the fine bodies are bucketed into cells at
+    // least the partner radius wide and each body scans the 3x3 around it.
+    size_t fineCount = 0;
+    float minX = 0.0f, minY = 0.0f, maxX = 0.0f, maxY = 0.0f, lightest = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        if (ideal[i] >= dt) continue;
+        if (fineCount == 0) {
+            minX = maxX = x[i];
+            minY = maxY = y[i];
+            lightest = mass[i];
+        }
+        minX = std::min(minX, x[i]);
+        maxX = std::max(maxX, x[i]);
+        minY = std::min(minY, y[i]);
+        maxY = std::max(maxY, y[i]);
+        lightest = std::min(lightest, mass[i]);
+        fineCount++;
+    }
+
+    if (fineCount > 0) {
+        const float radius = PARTNER_RADIUS * eps;
+        const float extent = std::max(maxX - minX, maxY - minY);
+        const float cellSize = std::max(radius, extent / MAX_PARTNER_CELLS);
+        const float invCell = 1.0f / cellSize;
+        const int cells = std::min(MAX_PARTNER_CELLS, static_cast<int>(extent * invCell) + 1);
+        auto cellOf = [=](float position, float origin) {
+            return std::min(cells - 1, static_cast<int>((position - origin) * invCell));
+        };
+
+        // Counting sort of the fine bodies by cell, in index order
+        fineCellStart.assign(static_cast<size_t>(cells) * cells + 1, 0);
+        for (size_t i = 0; i < n; i++) {
+            if (ideal[i] < dt) fineCellStart[cellOf(y[i], minY) * cells + cellOf(x[i], minX) + 1]++;
+        }
+        for (size_t c = 1; c < fineCellStart.size(); c++) fineCellStart[c] += fineCellStart[c - 1];
+        fineBodies.resize(fineCount);
+        std::vector<uint32_t> fill(fineCellStart.begin(), fineCellStart.end() - 1);
+        for (size_t i = 0; i < n; i++) {
+            if (ideal[i] < dt) {
+                fineBodies[fill[cellOf(y[i], minY) * cells + cellOf(x[i], minX)]++] = static_cast<uint32_t>(i);
+            }
+        }
+
+        const uint32_t* fine = fineBodies.data();
+        const uint32_t* cellStart = fineCellStart.data();
+        const float radius2 = radius * radius;
+        solver->forEachRange(n, [=](size_t begin, size_t end) {
+            for (size_t j = begin; j < end; j++) {
+                const float lighter = mass[j] / PARTNER_MASS_RATIO;
+                if (lightest > lighter) continue;
+                const float gx = (x[j] - minX) * invCell;
+                const float gy = (y[j] - minY) * invCell;
+                if (gx < -1.0f || gy < -1.0f || gx >= cells + 1.0f || gy >= cells + 1.0f) continue;
+                const int cx = static_cast<int>(std::floor(gx));
+                const int cy = static_cast<int>(std::floor(gy));
+
+                float step = ideal[j];
+                for (int ny = std::max(0, cy - 1); ny <= std::min(cells - 1, cy + 1); ny++) {
+                    for (int nx = std::max(0, cx - 1); nx <= std::min(cells - 1, cx + 1); nx++) {
+                        const int cell = ny * cells + nx;
+                        for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; k++) {
+                            const uint32_t i = fine[k];
+                            if (mass[i] > lighter) continue;
+                            const float dx = x[i] - x[j];
+                            const float dy = y[i] - y[j];
+                            const float r2 = dx * dx + dy * dy;
+                            if (r2 >= radius2) continue;
+                            const float relative = G * (mass[i] + mass[j]) / (r2 + eps * eps);
+                            step = std::min(step, eta * std::sqrt(eps / relative));
+                        }
+                    }
+                }
+                ideal[j] = step;
+            }
+        }, 256);
+    }
+
+    // Levels change only here, where every body is synchronized, so any
+    // level is commensurate with the base step
+    const bool history = stepLevel.size() == n;
+    stepLevel.resize(n);
+    uint8_t* levels = stepLevel.data();
+    int deepest = 0;
+    std::mutex deepestLock;
+
+    solver->forEachRange(n, [&](size_t begin, size_t end) {
+        int rangeDeepest = 0;
+        for (size_t i = begin; i < end; i++) {
+            int level = levelFor(dt, ideal[i], maxLevel);
+            if (history && level < levels[i]) {
+                level = std::min<int>(levels[i], levelFor(dt, ideal[i] / COARSEN_MARGIN, maxLevel));
+            }
+            levels[i] = static_cast<uint8_t>(level);
+            rangeDeepest = std::max(rangeDeepest, level);
+        }
+        std::lock_guard<std::mutex> lock(deepestLock);
+        deepest = std::max(deepest, rangeDeepest);
+    });
+
+    levelCounts.assign(deepest + 1, 0);
+    for (size_t i = 0; i < n; i++) levelCounts[stepLevel[i]]++;
+    return deepest;
+}
+
+void Simulation::computeActiveAccelerations() {
+    const size_t n = bodies.size();
+    const size_t active = activeBodies.size();
+
+    // The mesh is global, a partial evaluation would cost the same
+    if (active == n || forceMethod == ForceMethod::ParticleMesh) {
+        evaluateAllForces();
+        return;
+    }
+
+    PROFILE_SCOPE("forces (active)");
+    const float* x = bodies.x.data();
+    const float* y = bodies.y.data();
+    const float* mass = bodies.mass.data();
+    float* ax = bodies.ax.data();
+    float* ay = bodies.ay.data();
+    const uint32_t* ids = activeBodies.data();
+
+    if (forceMethod == ForceMethod::BarnesHut) {
+        tree.build(bodies);
+
+        solver->forEachRange(active, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                const uint32_t i = ids[k];
+                sf::Vector2f acc = tree.accelerationOn(i, theta, gravitationalConstant, softening);
+                ax[i] = acc.x;
+                ay[i] = acc.y;
+            }
+        }, 64);
+    } else {
+        // Gather the active targets so the kernel streams them contiguously
+        activeX.resize(active);
+        activeY.resize(active);
+        activeAx.assign(active, 0.0f);
+        activeAy.assign(active, 0.0f);
+        for (size_t k = 0; k < active; k++) {
+            activeX[k] = x[ids[k]];
+            activeY[k] = y[ids[k]];
+        }
+
+        const KernelTiles tiles = resolveKernelTiles(kernelTiles);
+        const size_t chunk = std::max<size_t>(64, std::min<size_t>(tiles.targetBlock, 1024));
+        const float eps2 = softening * softening;
+
+        solver->forEachRange(active, [&](size_t begin, size_t end) {
+            accumulateAccelerationsBlocked(activeX.data() + begin, activeY.data() + begin, end - begin,
+                                           x, y, mass, n, gravitationalConstant, eps2,
+                                           activeAx.data() + begin, activeAy.data() + begin, tiles);
+        }, chunk);
+
+        for (size_t k = 0; k < active; k++) {
+            ax[ids[k]] = activeAx[k];
+            ay[ids[k]] = activeAy[k];
+        }
+    }
+    forceEvaluations += active;
+}
+
+void Simulation::blockStep(float dt) {
+    // Levels are reassigned only at base step boundaries, where every body
+    // is synchronized and has accelerations for its current position
+    if (!accelerationsValid) evaluateAllForces();
+
+    const size_t n = bodies.size();
+    const int deepest = assignStepLevels(dt);
+    const uint32_t substeps = 1u << deepest;
+    const float h = dt / static_cast<float>(substeps);
+    const uint8_t* level = stepLevel.data();
+
+    float* x = bodies.x.data();
+    float* y = bodies.y.data();
+    float* vx = bodies.vx.data();
+    float* vy = bodies.vy.data();
+    const float* ax = bodies.ax.data();
+    const float* ay = bodies.ay.data();
+
+    for (uint32_t s = 0; s < substeps; s++) {
+        // Opening half-kick for bodies starting their own step, then every
+        // body drifts by one substep
+        solver->forEachRange(n, [=](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const uint32_t stride = 1u << (deepest - level[i]);
+                if ((s & (stride - 1)) == 0) {
+                    const float halfStep = 0.5f * h * static_cast<float>(stride);
+                    vx[i] += ax[i] * halfStep;
+                    vy[i] += ay[i] * halfStep;
+                }
+                x[i] += vx[i] * h;
+                y[i] += vy[i] * h;
+            }
+        });
+
+        // Bodies whose step ends here get new forces and their closing kick
+        activeBodies.clear();
+        for (size_t i = 0; i < n; i++) {
+            const uint32_t stride = 1u << (deepest - level[i]);
+            if (((s + 1) & (stride - 1)) == 0) activeBodies.push_back(static_cast<uint32_t>(i));
+        }
+
+        computeActiveAccelerations();
+
+        const size_t active = activeBodies.size();
+        const uint32_t* ids = activeBodies.data();
+        solver->forEachRange(active, [=](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                const uint32_t i = ids[k];
+                const float halfStep = 0.5f * h * static_cast<float>(1u << (deepest - level[i]));
+                vx[i] += ax[i] * halfStep;
+                vy[i] += ay[i] * halfStep;
+            }
+        });
+    }
+
+    // The last substep ends every body's step, so all accelerations are current
+    accelerationsValid = true;
+}
+
+double Simulation::totalEnergy() const {
+    const size_t n = bodies.size();
+    const float* x = bodies.x.data();
+    const float* y = bodies.y.data();
+    const float* vx = bodies.vx.data();
+    const float* vy = bodies.vy.data();
+    const float* mass = bodies.mass.data();
+    const double eps2 = static_cast<double>(softening) * softening;
+
+    double kinetic = 0.0;
+    double potential = 0.0;
+    std::mutex sumLock;
+
+    // Softened pair potential -G m_i m_j / sqrt(r^2 + eps^2), matching the force.
+    // Rows shrink with i, so they are handed out in small ranges.
+    solver->forEachRange(n, [&](size_t begin, size_t end) {
+        double rangeKinetic = 0.0;
+        double rangePotential = 0.0;
+        for (size_t i = begin; i < end; i++) {
+            rangeKinetic += 0.5 * mass[i] * (static_cast<double>(vx[i]) * vx[i] +
+                                             static_cast<double>(vy[i]) * vy[i]);
+            double row = 0.0;
+            for (size_t j = i + 1; j < n; j++) {
+                double dx = static_cast<double>(x[j]) - x[i];
+                double dy = static_cast<double>(y[j]) - y[i];
+                row += mass[j] / std::sqrt(dx * dx + dy * dy + eps2);
+            }
+            rangePotential -= gravitationalConstant * mass[i] * row;
+        }
+        std::lock_guard<std::mutex> lock(sumLock);
+        kinetic += rangeKinetic;
+        potential += rangePotential;
+    }, 64);
+
+    return kinetic + potential;
+}
@@ -0,0 +1,269 @@
+#include "ForceSolver.h"
+#include "Profiler.h"
+#include "Tiling.h"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+namespace {
+
+// A team of OpenMP threads of fixed size, passed to every parallel region
+class OpenMPSolver : public ForceSolver {
+public:
+    OpenMPSolver() : threads(omp_get_max_threads()), scratchStride(0) {}
+
+    const char* name() const override { return "openmp"; }
+    const char* label() const override { return "OpenMP"; }
+    int threadCount() const override { return threads; }
+    void setThreadCount(int count) override { threads = std::max(1, count); }
+
+    void computeAccelerations(const ForceRequest& request, const BodyRangeFn& then) override;
+    void forEachRange(size_t n, const BodyRangeFn& body, size_t grain) override;
+    void forEachThread(const std::function<void(int)>& fn) override;
+
+private:
+    int threads;
+
+    // Parallel direct-sum state, kept across steps so nothing is allocated per frame
+    TriangularTiling tiling;
+    AlignedVector<float> scratchAx, scratchAy;  // One n-sized slice per thread
+    size_t scratchStride;
+
+    void directSymmetric(const ForceRequest& request, const BodyRangeFn& then);
+    void directFullRow(const ForceRequest& request, const BodyRangeFn& then);
+};
+
+void OpenMPSolver::computeAccelerations(const ForceRequest& request, const BodyRangeFn& then) {
+    BodyStore& bodies = request.bodies;
+
+    if (request.method == ForceMethod::BarnesHut) {
+        const size_t n = bodies.size();
+        float* ax = bodies.ax.data();
+        float* ay = bodies.ay.data();
+        const QuadTree& tree = request.tree;
+        const float theta = request.theta;
+        const float G = request.gravitationalConstant;
+        const float softening = request.softening;
+
+        // Build the quadtree serially, then walk it for every body in parallel
+        {
+            PROFILE_SCOPE("tree build");
+            request.tree.build(bodies);
+        }
+
+        // Walks cost differently per body, so chunks are handed out on demand.
+        // Phases are timed on the calling thread around the whole region, as
+        // the pool times its parallelFor, so both report wall time.
+        const size_t chunk = 64;
+        const size_t chunks = (n + chunk - 1) / chunk;
+        PROFILE_SCOPE("tree walk");
+        #pragma omp parallel for schedule(dynamic) num_threads(threads)
+        for (size_t c = 0; c < chunks; c++) {
+            const size_t begin = c * chunk;
+            const size_t end = std::min(n, begin + chunk);
+            for (size_t i = begin; i < end; i++) {
+                sf::Vector2f acc = tree.accelerationOn(i, theta, G, softening);
+                ax[i] = acc.x;
+                ay[i] = acc.y;
+            }
+            if (then) then(begin, end);
+        }
+        return;
+    }
+
+    if (request.method == ForceMethod::ParticleMesh) {
+        // Deposit, FFTs and interpolation are parallel inside the mesh
+        meshAccelerations(request, threads);
+        if (then) forEachRange(bodies.size(), then, 0);
+        return;
+    }
+
+    if (threads == 1) {
+        // A team of one pays for the region and the reduction and gains
+        // nothing; the serial kernel is faster at every size
+        PROFILE_SCOPE("direct sum");
+        directAccelerations(request);
+        if (then) then(0, bodies.size());
+    } else if (request.directMode == DirectSumMode::FullRow) {
+        directFullRow(request, then);
+    } else {
+        directSymmetric(request, then);
+    }
+}
+
+void OpenMPSolver::directFullRow(const ForceRequest& request, const BodyRangeFn& then) {
+    BodyStore& bodies = request.bodies;
+    const size_t n = bodies.size();
+    float* x = bodies.x.data();
+    float* y = bodies.y.data();
+    float* ax = bodies.ax.data();
+    float* ay = bodies.ay.data();
+    const float* mass = bodies.mass.data();
+    const float G = request.gravitationalConstant;
+    const float eps2 = request.softening * request.softening;
+
+    // Rows are handed out in equal chunks, every row costs the same. Each
+    // chunk runs the cache-blocked kernel over all sources.
+    const KernelTiles tiles = resolveKernelTiles(request.kernelTiles);
+    size_t chunk = n / (4 * static_cast<size_t>(threads));
+    chunk = std::max<size_t>(64, std::min(chunk, tiles.targetBlock));
+    const size_t chunks = (n + chunk - 1) / chunk;
+
+    PROFILE_SCOPE("direct rows");
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (size_t c = 0; c < chunks; c++) {
+        const size_t begin = c * chunk;
+        const size_t count = std::min(chunk, n - begin);
+        std::fill(ax + begin, ax + begin + count, 0.0f);
+        std::fill(ay + begin, ay + begin + count, 0.0f);
+        accumulateAccelerationsBlocked(x + begin, y + begin, count, x, y, mass, n,
+                                       G, eps2, ax + begin, ay + begin, tiles);
+        if (then) then(begin, begin + count);
+    }
+}
+
+void OpenMPSolver::directSymmetric(const ForceRequest& request, const BodyRangeFn& then) {
+    BodyStore& bodies = request.bodies;
+    const size_t n = bodies.size();
+    float* x = bodies.x.data();
+    float* y = bodies.y.data();
+    float* ax = bodies.ax.data();
+    float* ay = bodies.ay.data();
+    const float* mass = bodies.mass.data();
+    const float G = request.gravitationalConstant;
+    const float eps2 = request.softening * request.softening;
+    const int max_threads = threads;
+
+    // Blocks small enough to give every thread several tiles, large enough to
+    // amortize the loop overhead; a tile's two blocks stay in L1
+    size_t block = n / (8 * static_cast<size_t>(max_threads));
+    block = std::max<size_t>(32, std::min<size_t>(256, block));
+    tiling.build(n, block);
+
+    // Per-thread buffers, padded to a cache line; only grown, never freed.
+    // They are zero on entry and the reduction below zeroes them again. Fresh
+    // buffers are left unwritten here so each thread first touches its own
+    // slice, and the slice's pages land on that thread's NUMA node. Slices
+    // have an eighth more room than needed, so inserting bodies keeps them.
+    const size_t needed = (n + 15) & ~size_t(15);
+    const bool freshScratch = needed > scratchStride || scratchStride * max_threads > scratchAx.size();
+    if (freshScratch) {
+        scratchStride = (needed + needed / 8 + 15) & ~size_t(15);
+        AlignedVector<float>().swap(scratchAx);
+        AlignedVector<float>().swap(scratchAy);
+        scratchAx.resize(scratchStride * max_threads);
+        scratchAy.resize(scratchStride * max_threads);
+    }
+    const size_t stride = scratchStride;
+
+    // Two regions rather than one with a barrier, so each phase is timed on
+    // the calling thread like the pool's two parallelFor calls
+    {
+        PROFILE_SCOPE("direct pairs");
+        #pragma omp parallel num_threads(max_threads)
+        {
+            const int num_threads = omp_get_num_threads();
+            const int thread_id = omp_get_thread_num();
+            float* localAx = scratchAx.data() + thread_id * stride;
+            float* localAy = scratchAy.data() + thread_id * stride;
+            if (freshScratch) {
+                std::fill(localAx, localAx + stride, 0.0f);
+                std::fill(localAy, localAy + stride, 0.0f);
+            }
+
+            // Contiguous run of tiles with an equal share of the pairs
+            std::pair<size_t, size_t> tiles = tiling.range(thread_id, num_threads);
+
+            for (size_t t = tiles.first; t < tiles.second; t++) {
+                const TriangularTiling::Tile& tile = tiling[t];
+
+                for (size_t i = tile.iBegin; i < tile.iEnd; i++) {
+                    const float xi = x[i];
+                    const float yi = y[i];
+                    const float mi = mass[i];
+                    float axi = 0.0f, ayi = 0.0f;
+                    const size_t jBegin = (tile.iBegin == tile.jBegin) ? i + 1 : tile.jBegin;
+
+                    for (size_t j = jBegin; j < tile.jEnd; j++) {
+                        float dx = x[j] - xi;
+                        float dy = y[j] - yi;
+                        float distSquared = dx * dx + dy * dy + eps2;
+                        float invDistance = 1.0f / std::sqrt(distSquared);
+                        float scale = G * invDistance * invDistance * invDistance;
+
+                        // Equal and opposite accelerations, the j side goes to the thread's buffer
+                        axi += dx * scale * mass[j];
+                        ayi += dy * scale * mass[j];
+                        localAx[j] -= dx * scale * mi;
+                        localAy[j] -= dy * scale * mi;
+                    }
+
+                    localAx[i] += axi;
+                    localAy[i] += ayi;
+                }
+            }
+        }
+    }
+
+    // Reduce the thread buffers and clear them for the next step. The
+    // slices match the first-touch split, and the follow-up runs on each
+    // slice while it is still in cache.
+    PROFILE_SCOPE("reduce");
+    #pragma omp parallel num_threads(max_threads)
+    {
+        const int num_threads = omp_get_num_threads();
+        const int thread_id = omp_get_thread_num();
+        const size_t begin = n * thread_id / num_threads;
+        const size_t end = n * (thread_id + 1) / num_threads;
+        for (size_t i = begin; i < end; i++) {
+            float axi = 0.0f, ayi = 0.0f;
+            for (int t = 0; t < num_threads; t++) {
+                axi += scratchAx[t * stride + i];
+                ayi += scratchAy[t * stride + i];
+                scratchAx[t * stride + i] = 0.0f;
+                scratchAy[t * stride + i] = 0.0f;
+            }
+            ax[i] = axi;
+            ay[i] = ayi;
+        }
+        if (then) then(begin, end);
+    }
+}
+
+void OpenMPSolver::forEachRange(size_t n, const BodyRangeFn& body, size_t grain) {
+    if (n == 0) return;
+    if (threads == 1) {
+        // The master thread of a team of one is the calling thread
+        body(0, n);
+        return;
+    }
+
+    if (grain == 0) {
+        #pragma omp parallel num_threads(threads)
+        {
+            const size_t count = static_cast<size_t>(omp_get_num_threads());
+            const size_t thread = static_cast<size_t>(omp_get_thread_num());
+            body(n * thread / count, n * (thread + 1) / count);
+        }
+        return;
+    }
+
+    const size_t chunks = (n + grain - 1) / grain;
+    #pragma omp parallel for schedule(dynamic) num_threads(threads)
+    for (size_t c = 0; c < chunks; c++) {
+        body(c * grain, std::min(n, (c + 1) * grain));
+    }
+}
+
+void OpenMPSolver::forEachThread(const std::function<void(int)>& fn) {
+    #pragma omp parallel num_threads(threads)
+    {
+        fn(omp_get_thread_num());
+    }
+}
+
+const bool registered = registerForceSolver("openmp", []() -> std::unique_ptr<ForceSolver> {
+    return std::unique_ptr<ForceSolver>(new OpenMPSolver());
+});
+
+} // namespace
@@ -0,0 +1,340 @@
+#include "ParticleMesh.h"
+#include "BodyStore.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Mesh rows deposited by one task. Stencils reach at most 2 rows past their
+// first, so tasks two bands apart never write the same node.
+const int DEPOSIT_BAND = 8;
+
+// Mass assignment stencil along one axis: first node and up to 3 weights
+struct Stencil {
+    int first;
+    int count;
+    float w[3];
+};
+
+inline Stencil makeStencil(float u, MassAssignment assignment) {
+    Stencil s;
+    if (assignment == MassAssignment::TSC) {
+        int nearest = static_cast<int>(std::floor(u + 0.5f));
+        float d = u - static_cast<float>(nearest);
+        s.first = nearest - 1;
+        s.count = 3;
+        s.w[0] = 0.5f * (0.5f - d) * (0.5f - d);
+        s.w[1] = 0.75f - d * d;
+        s.w[2] = 0.5f * (0.5f + d) * (0.5f + d);
+    } else {
+        int lower = static_cast<int>(std::floor(u));
+        float f = u - static_cast<float>(lower);
+        s.first = lower;
+        s.count = 2;
+        s.w[0] = 1.0f - f;
+        s.w[1] = f;
+        s.w[2] = 0.0f;
+    }
+    return s;
+}
+
+// Fraction of the 1/r^2 force carried by the short-range part of a Gaussian
+// split at scale rs (the mesh carries the rest)
+inline float shortRangeFraction(float r, float rs) {
+    float u = r / (2.0f * rs);
+    return std::erfc(u) + 1.1283792f * u * std::exp(-u * u);  // 2 / sqrt(pi)
+}
+
+} // namespace
+
+void ParticleMesh::setSettings(const Settings& s) {
+    settings = s;
+
+    // Round the grid up to a power of two the FFT can handle
+    int g = 16;
+    while (g < settings.gridSize && g < 8192) g <<= 1;
+    settings.gridSize = g;
+
+    domainValid = false;
+    kernelSoftening = -1.0f;
+}
+
+void ParticleMesh::fitDomain(const BodyStore& bodies) {
+    const size_t n = bodies.size();
+    const float* x = bodies.x.data();
+    const float* y = bodies.y.data();
+
+    float minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+    #pragma omp parallel for reduction(min:minX, minY) reduction(max:maxX, maxY)
+    for (size_t i = 0; i < n; i++) {
+        minX = std::min(minX, x[i]);
+        maxX = std::max(maxX, x[i]);
+        minY = std::min(minY, y[i]);
+        maxY = std::max(maxY, y[i]);
+    }
+
+    // Keep the current domain while every body is at least 2 cells inside the
+    // border (room for the TSC stencil) and the bodies still fill a good part of it
+    if (domainValid && grid == settings.gridSize) {
+        const float lo = 2.0f * cellSize;
+        const float hi = (grid - 2) * cellSize;
+        const float extent = std::max(maxX - minX, maxY - minY);
+        bool inside = minX - originX >= lo && maxX - originX < hi &&
+                      minY - originY >= lo && maxY - originY < hi;
+        bool wellFilled = extent > 0.25f * grid * cellSize;
+        if (inside && wellFilled) return;
+    }
+
+    // Refit with a 25% margin so slowly spreading systems rarely trigger a rebuild
+    grid = settings.gridSize;
+    const float extent = std::max(std::max(maxX - minX, maxY - minY), 1.0f) * 1.25f;
+    cellSize = extent / static_cast<float>(grid - 4);
+    originX = 0.5f * (minX + maxX) - 0.5f * grid * cellSize;
+    originY = 0.5f * (minY + maxY) - 0.5f * grid * cellSize;
+    domainValid = true;
+}
+
+void ParticleMesh::buildKernel(float G, float softening) {
+    if (kernelCellSize == cellSize && kernelSoftening == softening && kernelG == G &&
+        kernelShortRange == settings.shortRange && !kernelHat.empty()) {
+        return;
+    }
+
+    const int N = 2 * grid;
+    const float eps2 = softening * softening;
+    const float rs = splitScale();
+
+    // Without the short-range correction the mesh cannot resolve separations
+    // below a cell, so the kernel is additionally softened by one cell
+    const float meshSoftening2 = eps2 + cellSize * cellSize;
+
+    fft.init(N);
+    kernelHat.assign(static_cast<size_t>(N) * N, Complex(0.0f, 0.0f));
+
+    // Acceleration at offset d from a unit mass: -G d / (|d|^2 + s^2)^(3/2),
+    // stored as x + i y so one complex product yields both components
+    #pragma omp parallel for schedule(static)
+    for (int iy = 0; iy < N; iy++) {
+        const float dy = static_cast<float>(iy < grid ? iy : iy - N) * cellSize;
+        for (int ix = 0; ix < N; ix++) {
+            const float dx = static_cast<float>(ix < grid ? ix : ix - N) * cellSize;
+            const float r2 = dx * dx + dy * dy;
+            float scale;
+            if (settings.shortRange) {
+                const float distSquared = r2 + eps2;
+                const float longRange = 1.0f - shortRangeFraction(std::sqrt(r2), rs);
+                scale = -G * longRange / (distSquared * std::sqrt(distSquared));
+            } else {
+                const float distSquared = r2 + meshSoftening2;
+                scale = -G / (distSquared * std::sqrt(distSquared));
+            }
+            kernelHat[static_cast<size_t>(iy) * N + ix] = Complex(dx * scale, dy * scale);
+        }
+    }
+
+    fft.forward(kernelHat);
+
+    kernelCellSize = cellSize;
+    kernelSoftening = softening;
+    kernelG = G;
+    kernelShortRange = settings.shortRange;
+}
+
+void ParticleMesh::deposit(const BodyStore& bodies) {
+    const size_t n = bodies.size();
+    const int N = 2 * grid;
+    const float invCell = 1.0f / cellSize;
+    const MassAssignment assignment = settings.assignment;
+    const float* x = bodies.x.data();
+    const float* y = bodies.y.data();
+    const float* mass = bodies.mass.data();
+
+    std::fill(work.begin(), work.end(), Complex(0.0f, 0.0f));
+    float* grid2 = reinterpret_cast<float*>(work.data());  // Interleaved re, im
+
+    // Bucket the bodies by stencil row with a counting sort that keeps index order
+    bodyRow.resize(n);
+    int* rows = bodyRow.data();
+    const int lastRow = grid - 1;
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+        const int first = makeStencil((y[i] - originY) * invCell, assignment).first;
+        rows[i] = std::min(lastRow, std::max(0, first));
+    }
+    rowStart.assign(grid + 1, 0);
+    for (size_t i = 0; i < n; i++) rowStart[rows[i] + 1]++;
+    for (int r = 1; r <= grid; r++) rowStart[r] += rowStart[r - 1];
+    rowBodies.resize(n);
+    std::vector<int> fill(rowStart.begin(), rowStart.end() - 1);
+    for (size_t i = 0; i < n; i++) rowBodies[fill[rows[i]]++] = static_cast<int>(i);
+
+    // Even bands, then odd ones: no two tasks share a node, so the adds need
+    // no atomics and every node sums its masses in the same order whatever
+    // the thread count, which keeps the density reproducible
+    const int bands = (grid + DEPOSIT_BAND - 1) / DEPOSIT_BAND;
+    for (int parity = 0; parity < 2; parity++) {
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int band = parity; band < bands; band += 2) {
+            const int begin = rowStart[band * DEPOSIT_BAND];
+            const int end = rowStart[std::min(grid, (band + 1) * DEPOSIT_BAND)];
+            for (int k = begin; k < end; k++) {
+                const int i = rowBodies[k];
+                Stencil sx = makeStencil((x[i] - originX) * invCell, assignment);
+                Stencil sy = makeStencil((y[i] - originY) * invCell, assignment);
+                for (int b = 0; b < sy.count; b++) {
+                    const size_t row = static_cast<size_t>(sy.first + b) * N;
+                    for (int a = 0; a < sx.count; a++) {
+                        grid2[2 * (row + sx.first + a)] += mass[i] * sx.w[a] * sy.w[b];
+                    }
+                }
+            }
+        }
+    }
+}
+
+void ParticleMesh::interpolate(const BodyStore& bodies, float* ax, float* ay) const {
+    const size_t n = bodies.size();
+    const int N = 2 * grid;
+    const float invCell = 1.0f / cellSize;
+    const float norm = 1.0f / (static_cast<float>(N) * static_cast<float>(N));
+    const MassAssignment assignment = settings.assignment;
+    const float* x = bodies.x.data();
+    const float* y = bodies.y.data();
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+        Stencil sx = makeStencil((x[i] - originX) * invCell, assignment);
+        Stencil sy = makeStencil((y[i] - originY) * invCell, assignment);
+        float fx = 0.0f, fy = 0.0f;
+        for (int b = 0; b < sy.count; b++) {
+            const size_t row = static_cast<size_t>(sy.first + b) * N;
+            for (int a = 0; a < sx.count; a++) {
+                const Complex& field = work[row + sx.first + a];
+                const float w = sx.w[a] * sy.w[b];
+                fx += w * field.real();
+                fy += w * field.imag();
+            }
+        }
+        ax[i] = fx * norm;
+        ay[i] = fy * norm;
+    }
+}
+
+void ParticleMesh::addShortRange(const BodyStore& bodies, float G, float softening,
+                                 float* ax, float* ay) {
+    const size_t n = bodies.size();
+    const float* x = bodies.x.data();
+    const float* y = bodies.y.data();
+    const float* mass = bodies.mass.data();
+    const float eps2 = softening * softening;
+    const float rs = splitScale();
+    const float cutoff = cutoffRadius();
+    const float cutoff2 = cutoff * cutoff;
+
+    // Chaining mesh with cells at least one cutoff wide, filled by counting sort
+    const float span = grid * cellSize;
+    chainCells = std::max(1, static_cast<int>(span / cutoff));
+    chainSize = span / static_cast<float>(chainCells);
+    const float invChain = 1.0f / chainSize;
+
+    auto cellOf = [&](size_t i, int& cx, int& cy) {
+        cx = std::min(chainCells - 1, std::max(0, static_cast<int>((x[i] - originX) * invChain)));
+        cy = std::min(chainCells - 1, std::max(0, static_cast<int>((y[i] - originY) * invChain)));
+    };
+
+    cellStart.assign(static_cast<size_t>(chainCells) * chainCells + 1, 0);
+    cellBodies.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        int cx, cy;
+        cellOf(i, cx, cy);
+        cellStart[cy * chainCells + cx + 1]++;
+    }
+    for (size_t c = 1; c < cellStart.size(); c++) cellStart[c] += cellStart[c - 1];
+    std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+    for (size_t i = 0; i < n; i++) {
+        int cx, cy;
+        cellOf(i, cx, cy);
+        cellBodies[fill[cy * chainCells + cx]++] = static_cast<int>(i);
+    }
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (size_t i = 0; i < n; i++) {
+        int cx, cy;
+        cellOf(i, cx, cy);
+        float accX = 0.0f, accY = 0.0f;
+
+        for (int ny = std::max(0, cy - 1); ny <= std::min(chainCells - 1, cy + 1); ny++) {
+            for (int nx = std::max(0, cx - 1); nx <= std::min(chainCells - 1, cx + 1); nx++) {
+                const int cell = ny * chainCells + nx;
+                for (int k = cellStart[cell]; k < cellStart[cell + 1]; k++) {
+                    const int j = cellBodies[k];
+                    const float dx = x[j] - x[i];
+                    const float dy = y[j] - y[i];
+                    const float r2 = dx * dx + dy * dy;
+                    if (r2 >= cutoff2 || static_cast<size_t>(j) == i) continue;
+
+                    const float distSquared = r2 + eps2;
+                    const float scale = G * mass[j] * shortRangeFraction(std::sqrt(r2), rs) /
+                                        (distSquared * std::sqrt(distSquared));
+                    accX += dx * scale;
+                    accY += dy * scale;
+                }
+            }
+        }
+
+        ax[i] += accX;
+        ay[i] += accY;
+    }
+}
+
+void ParticleMesh::computeAccelerations(const BodyStore& bodies, float G, float softening,
+                                        float* ax, float* ay) {
+    if (bodies.empty()) return;
+
+    fitDomain(bodies);
+    buildKernel(G, softening);
+
+    const size_t N = 2 * static_cast<size_t>(grid);
+    work.resize(N * N);
+
+    // Mass onto the mesh, convolve with the kernel, read the field back
+    {
+        PROFILE_SCOPE("pm deposit");
+        deposit(bodies);
+    }
+    {
+        PROFILE_SCOPE("pm convolve");
+        fft.forward(work);
+
+        #pragma omp parallel for schedule(static)
+        for (size_t k = 0; k < N * N; k++) {
+            work[k] *= kernelHat[k];
+        }
+
+        fft.inverse(work);
+    }
+    {
+        PROFILE_SCOPE("pm interpolate");
+        interpolate(bodies, ax, ay);
+    }
+
+    if (settings.shortRange) {
+        PROFILE_SCOPE("p3m short range");
+        addShortRange(bodies, G, softening, ax, ay);
+    }
+}
+
+ForceError measureParticleMeshError(const BodyStore& bodies, const ParticleMesh::Settings& settings,
+                                    float G, float softening, int samples) {
+    const size_t n = bodies.size();
+    if (n < 2 || samples <= 0) return ForceError{0.0f, 0.0f, 0};
+
+    ParticleMesh mesh;
+    mesh.setSettings(settings);
+    std::vector<float> ax(n), ay(n);
+    mesh.computeAccelerations(bodies, G, softening, ax.data(), ay.data());
+
+    return compareWithDirectSum(bodies.x.data(), bodies.y.data(), bodies.mass.data(), n,
+                                ax.data(), ay.data(), G, softening * softening, samples);
+}
@@ -0,0 +1,228 @@
+#include "ForceSolver.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include "Tiling.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Persistent workers that steal chunks from each other, see ThreadPool
+class PoolSolver : public ForceSolver {
+public:
+    PoolSolver() : pool(ThreadPool::defaultSize()), scratchStride(0) {}
+
+    const char* name() const override { return "pool"; }
+    const char* label() const override { return "Pool"; }
+    int threadCount() const override { return pool.size(); }
+
+    void setThreadCount(int count) override {
+        if (count != pool.size()) pool.resize(count);
+    }
+
+    void computeAccelerations(const ForceRequest& request, const BodyRangeFn& then) override;
+
+    void forEachRange(size_t n, const BodyRangeFn& body, size_t grain) override {
+        if (n > 0) pool.parallelFor(n, body, grain);
+    }
+
+    void forEachThread(const std::function<void(int)>& fn) override {
+        pool.forEachWorker(fn);
+    }
+
+private:
+    ThreadPool pool;
+
+    // Parallel direct-sum state, kept across steps so nothing is allocated per frame
+    TriangularTiling tiling;
+    AlignedVector<float> scratchAx, scratchAy;  // One n-sized slice per worker
+    size_t scratchStride;
+
+    void directSymmetric(const ForceRequest& request, const BodyRangeFn& then);
+    void directFullRow(const ForceRequest& request, const BodyRangeFn& then);
+};
+
+void PoolSolver::computeAccelerations(const ForceRequest& request, const BodyRangeFn& then) {
+    BodyStore& bodies = request.bodies;
+    const size_t n = bodies.size();
+
+    if (request.method == ForceMethod::BarnesHut) {
+        float* ax = bodies.ax.data();
+        float* ay = bodies.ay.data();
+        const QuadTree& tree = request.tree;
+
+        // Build the quadtree serially, then walk it for every body; walks
+        // cost differently per body, stealing evens that out
+        {
+            PROFILE_SCOPE("tree build");
+            request.tree.build(bodies);
+        }
+
+        PROFILE_SCOPE("tree walk");
+        pool.parallelFor(n, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                sf::Vector2f acc = tree.accelerationOn(i, request.theta, request.gravitationalConstant,
+                                                       request.softening);
+                ax[i] = acc.x;
+                ay[i] = acc.y;
+            }
+            if (then) then(begin, end);
+        }, 64);
+        return;
+    }
+
+    if (request.method == ForceMethod::ParticleMesh) {
+        // The mesh loops are OpenMP; a team the size of the pool keeps them
+        // as parallel as on the OpenMP backend
+        meshAccelerations(request, pool.size());
+        if (then) forEachRange(n, then, 0);
+        return;
+    }
+
+    if (pool.size() == 1) {
+        // Nothing to steal and nobody to share pairs with, see OpenMPSolver
+        PROFILE_SCOPE("direct sum");
+        directAccelerations(request);
+        if (then) then(0, n);
+    } else if (request.directMode == DirectSumMode::FullRow) {
+        directFullRow(request, then);
+    } else {
+        directSymmetric(request, then);
+    }
+}
+
+void PoolSolver::directFullRow(const ForceRequest& request, const BodyRangeFn& then) {
+    BodyStore& bodies = request.bodies;
+    const size_t n = bodies.size();
+    float* x = bodies.x.data();
+    float* y = bodies.y.data();
+    float* ax = bodies.ax.data();
+    float* ay = bodies.ay.data();
+    const float* mass = bodies.mass.data();
+    const float G = request.gravitationalConstant;
+    const float eps2 = request.softening * request.softening;
+    const KernelTiles tiles = resolveKernelTiles(request.kernelTiles);
+
+    // Each chunk of rows runs the cache-blocked kernel over all sources and
+    // then its follow-up, with no pass in between
+    PROFILE_SCOPE("direct rows");
+    pool.parallelFor(n, [&](size_t begin, size_t end) {
+        const size_t count = end - begin;
+        std::fill(ax + begin, ax + end, 0.0f);
+        std::fill(ay + begin, ay + end, 0.0f);
+        accumulateAccelerationsBlocked(x + begin, y + begin, count, x, y, mass, n,
+                                       G, eps2, ax + begin, ay + begin, tiles);
+        if (then) then(begin, end);
+    }, 64);
+}
+
+void PoolSolver::directSymmetric(const ForceRequest& request, const BodyRangeFn& then) {
+    BodyStore& bodies = request.bodies;
+    const size_t n = bodies.size();
+    float* x = bodies.x.data();
+    float* y = bodies.y.data();
+    float* ax = bodies.ax.data();
+    float* ay = bodies.ay.data();
+    const float* mass = bodies.mass.data();
+    const float G = request.gravitationalConstant;
+    const float eps2 = request.softening * request.softening;
+    const size_t workers = static_cast<size_t>(pool.size());
+
+    // Blocks small enough to give every worker several tiles, large enough
+    // to amortize the loop overhead; a tile's two blocks stay in L1
+    size_t block = n / (8 * workers);
+    block = std::max<size_t>(32, std::min<size_t>(256, block));
+    tiling.build(n, block);
+
+    // Per-worker buffers, padded to a cache line; only grown, never freed.
+    // They are zero on entry and the reduction below zeroes them again.
+    // Slices have an eighth more room than needed, so inserting bodies keeps them.
+    const size_t needed = (n + 15) & ~size_t(15);
+    if (needed > scratchStride || scratchStride * workers > scratchAx.size()) {
+        scratchStride = (needed + needed / 8 + 15) & ~size_t(15);
+        AlignedVector<float>().swap(scratchAx);
+        AlignedVector<float>().swap(scratchAy);
+        scratchAx.resize(scratchStride * workers);
+        scratchAy.resize(scratchStride * workers);
+
+        // Every worker first touches its own slice
+        pool.forEachWorker([&](int worker) {
+            float* localAx = scratchAx.data() + worker * scratchStride;
+            float* localAy = scratchAy.data() + worker * scratchStride;
+            std::fill(localAx, localAx + scratchStride, 0.0f);
+            std::fill(localAy, localAy + scratchStride, 0.0f);
+        });
+    }
+    const size_t stride = scratchStride;
+
+    // Tiles are taken in small runs; diagonal tiles hold half the pairs of
+    // the others, and stealing evens out the difference
+    {
+        PROFILE_SCOPE("direct pairs");
+        pool.parallelFor(tiling.size(), [&](size_t first, size_t last) {
+            // Local copies: through the by-reference captures GCC cannot
+            // rule out aliasing and leaves the pair loop scalar
+            const float* __restrict px = x;
+            const float* __restrict py = y;
+            const float* __restrict pm = mass;
+            const float g = G;
+            const float e2 = eps2;
+            const size_t worker = static_cast<size_t>(ThreadPool::currentWorker());
+            float* __restrict localAx = scratchAx.data() + worker * stride;
+            float* __restrict localAy = scratchAy.data() + worker * stride;
+
+            for (size_t t = first; t < last; t++) {
+                const TriangularTiling::Tile& tile = tiling[t];
+
+                for (size_t i = tile.iBegin; i < tile.iEnd; i++) {
+                    const float xi = px[i];
+                    const float yi = py[i];
+                    const float mi = pm[i];
+                    float axi = 0.0f, ayi = 0.0f;
+                    const size_t jBegin = (tile.iBegin == tile.jBegin) ? i + 1 : tile.jBegin;
+
+                    for (size_t j = jBegin; j < tile.jEnd; j++) {
+                        float dx = px[j] - xi;
+                        float dy = py[j] - yi;
+                        float distSquared = dx * dx + dy * dy + e2;
+                        float invDistance = 1.0f / std::sqrt(distSquared);
+                        float scale = g * invDistance * invDistance * invDistance;
+
+                        // Equal and opposite accelerations, the j side goes to the worker's buffer
+                        axi += dx * scale * pm[j];
+                        ayi += dy * scale * pm[j];
+                        localAx[j] -= dx * scale * mi;
+                        localAy[j] -= dy * scale * mi;
+                    }
+
+                    localAx[i] += axi;
+                    localAy[i] += ayi;
+                }
+            }
+        }, 1);
+    }
+
+    // Reduce the worker buffers, clear them for the next step and run the
+    // follow-up on each range while it is still in cache
+    PROFILE_SCOPE("reduce");
+    pool.parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float axi = 0.0f, ayi = 0.0f;
+            for (size_t w = 0; w < workers; w++) {
+                axi += scratchAx[w * stride + i];
+                ayi += scratchAy[w * stride + i];
+                scratchAx[w * stride + i] = 0.0f;
+                scratchAy[w * stride + i] = 0.0f;
+            }
+            ax[i] = axi;
+            ay[i] = ayi;
+        }
+        if (then) then(begin, end);
+    });
+}
+
+const bool registered = registerForceSolver("pool", []() -> std::unique_ptr<ForceSolver> {
+    return std::unique_ptr<ForceSolver>(new PoolSolver());
+});
+
+} // namespace
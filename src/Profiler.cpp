@@ -0,0 +1,172 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Profiler::enabled(false);
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Each thread appends to its own log without locking; the registry only
+// locks when a thread records for the first time
+struct ThreadLog {
+    uint32_t id;
+    std::string name;
+    std::vector<Event> events;
+    uint64_t dropped = 0;
+};
+
+const size_t MAX_EVENTS_PER_THREAD = size_t(1) << 22;
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadLog>> registry;
+uint64_t traceStart = Profiler::now();
+
+ThreadLog& threadLog() {
+    thread_local ThreadLog* log = nullptr;
+    if (!log) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<ThreadLog>());
+        log = registry.back().get();
+        log->id = static_cast<uint32_t>(registry.size());
+        log->name = "thread " + std::to_string(log->id);
+        log->events.reserve(4096);
+    }
+    return *log;
+}
+
+std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+} // namespace
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+    ThreadLog& log = threadLog();
+    if (log.events.size() >= MAX_EVENTS_PER_THREAD) {
+        log.dropped++;
+        return;
+    }
+    log.events.push_back(Event{name, start, end});
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    threadLog().name = name;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    uint64_t dropped = 0;
+
+    for (const std::unique_ptr<ThreadLog>& log : registry) {
+        file << (first ? "" : ",\n")
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log->id
+             << ",\"args\":{\"name\":\"" << escapeJson(log->name) << "\"}}";
+        first = false;
+
+        // Complete events, timestamps and durations in microseconds
+        for (const Event& e : log->events) {
+            file << ",\n{\"name\":\"" << escapeJson(e.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << log->id
+                 << std::fixed << std::setprecision(3)
+                 << ",\"ts\":" << (e.start - std::min(e.start, traceStart)) / 1000.0
+                 << ",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+        }
+        dropped += log->dropped;
+    }
+    file << "\n]}\n";
+
+    std::cout << "Trace written to " << path;
+    if (dropped > 0) std::cout << " (" << dropped << " events dropped, per-thread log full)";
+    std::cout << std::endl;
+    return true;
+}
+
+void Profiler::printSummary(std::ostream& out) {
+    std::map<std::string, std::vector<uint64_t>> phases;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const std::unique_ptr<ThreadLog>& log : registry) {
+            for (const Event& e : log->events) {
+                phases[e.name].push_back(e.end - e.start);
+            }
+        }
+    }
+    if (phases.empty()) return;
+
+    // Nearest-rank percentile in milliseconds
+    auto percentile = [](const std::vector<uint64_t>& sorted, double p) {
+        size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.5);
+        rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+        return sorted[rank - 1] / 1e6;
+    };
+
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::left << std::setw(22) << "Phase" << std::right
+        << std::setw(10) << "Count" << std::setw(12) << "Total ms"
+        << std::setw(10) << "p50" << std::setw(10) << "p95"
+        << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+
+    for (auto& phase : phases) {
+        std::vector<uint64_t>& durations = phase.second;
+        std::sort(durations.begin(), durations.end());
+        uint64_t total = 0;
+        for (uint64_t d : durations) total += d;
+
+        out << std::left << std::setw(22) << phase.first << std::right
+            << std::setw(10) << durations.size()
+            << std::fixed << std::setprecision(1) << std::setw(12) << total / 1e6
+            << std::setprecision(3)
+            << std::setw(10) << percentile(durations, 50)
+            << std::setw(10) << percentile(durations, 95)
+            << std::setw(10) << percentile(durations, 99)
+            << std::setw(10) << durations.back() / 1e6 << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+std::map<std::string, Profiler::PhaseTotal> Profiler::phaseTotals() {
+    std::map<std::string, PhaseTotal> totals;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::unique_ptr<ThreadLog>& log : registry) {
+        for (const Event& e : log->events) {
+            PhaseTotal& total = totals[e.name];
+            total.count++;
+            total.nanoseconds += e.end - e.start;
+        }
+    }
+    return totals;
+}
+
+void Profiler::clear() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::unique_ptr<ThreadLog>& log : registry) {
+        log->events.clear();
+        log->dropped = 0;
+    }
+}
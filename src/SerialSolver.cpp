@@ -0,0 +1,62 @@
+#include "ForceSolver.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace {
+
+// Everything on the calling thread
+class SerialSolver : public ForceSolver {
+public:
+    const char* name() const override { return "serial"; }
+    const char* label() const override { return "Serial"; }
+    int threadCount() const override { return 1; }
+    void setThreadCount(int) override {}
+
+    void computeAccelerations(const ForceRequest& request, const BodyRangeFn& then) override {
+        BodyStore& bodies = request.bodies;
+        const size_t n = bodies.size();
+        float* ax = bodies.ax.data();
+        float* ay = bodies.ay.data();
+        const float G = request.gravitationalConstant;
+
+        if (request.method == ForceMethod::BarnesHut) {
+            // Approximate far-field forces with the quadtree
+            {
+                PROFILE_SCOPE("tree build");
+                request.tree.build(bodies);
+            }
+            PROFILE_SCOPE("tree walk");
+            for (size_t i = 0; i < n; i++) {
+                sf::Vector2f acc = request.tree.accelerationOn(i, request.theta, G, request.softening);
+                ax[i] = acc.x;
+                ay[i] = acc.y;
+            }
+        } else if (request.method == ForceMethod::ParticleMesh) {
+            std::fill(bodies.ax.begin(), bodies.ax.end(), 0.0f);
+            std::fill(bodies.ay.begin(), bodies.ay.end(), 0.0f);
+            meshAccelerations(request, 1);
+        } else {
+            // Full rows through the vectorized kernel: twice the interactions of
+            // the symmetric i<j loop, but 8-16 of them per instruction. Blocking
+            // keeps the source stream in cache instead of memory for large n.
+            PROFILE_SCOPE("direct sum");
+            directAccelerations(request);
+        }
+
+        if (then) then(0, n);
+    }
+
+    void forEachRange(size_t n, const BodyRangeFn& body, size_t) override {
+        if (n > 0) body(0, n);
+    }
+
+    void forEachThread(const std::function<void(int)>& fn) override {
+        fn(0);
+    }
+};
+
+const bool registered = registerForceSolver("serial", []() -> std::unique_ptr<ForceSolver> {
+    return std::unique_ptr<ForceSolver>(new SerialSolver());
+});
+
+} // namespace
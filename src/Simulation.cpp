@@ -1,151 +1,132 @@
 #include "Simulation.h"
-#include <random>
+#include "Profiler.h"
 #include <cmath>
+#include <algorithm>
 
 Simulation::Simulation(float g, float soften, float dt, float w, float h)
-    : gravitationalConstant(g), softening(soften), timeStep(dt), width(w), height(h) {}
-
-void Simulation::initializeRandomBodies(int n, float maxMassSmall, float MaxMassBig) {
-    bodies.clear();
-
-    float massCentral = 50000.0f;
-        
-    // Add massive central body
-    bodies.emplace_back(
-        sf::Vector2f(width/2, height/2),       // Position at center
-        sf::Vector2f(0, 0),                    // No initial velocity
-        massCentral,                              // Very large mass
-        10.0f,                                 // Larger radius
-        sf::Color(255, 255, 255)                // Bright yellow/gold
-    );
-
-   
-    // Random number generation
-    std::random_device rd;
-    std::mt19937 gen(rd());
-
-    // Generate orbiting bodies (big)
-    for (int i = 0; i <  n / 50; i++) {
-        // Generate random angle and distance from center
-        std::uniform_real_distribution<float> angleDist(0.0f, 2.0f * M_PI);
-        std::uniform_real_distribution<float> distDist(250.0f, std::min(width, height)/2 - 50.0f);
-        std::uniform_real_distribution<float> massDist(1000.0f, MaxMassBig);
-        std::uniform_real_distribution<float> radiusDist(4.0f, 9.0f);
-        std::uniform_real_distribution<float> orbitTypeDist(0.7f, 1.0f);
-        
-        float angle = angleDist(gen);
-        float distance = distDist(gen);
-        float orbitFactor = orbitTypeDist(gen);
-        
-        // Calculate position based on angle and distance
-        sf::Vector2f pos(
-            width/2 + distance * cos(angle),
-            height/2 + distance * sin(angle)
-        );
-        
-        // Calculate orbital velocity for a circular orbit
-        float baseOrbitalSpeed = sqrt(gravitationalConstant * massCentral / distance);
-        
-        float orbitalSpeed = baseOrbitalSpeed * orbitFactor;
-        
-        // Velocity perpendicular to radius vector (for circular orbit)
-        sf::Vector2f vel(
-            -orbitalSpeed * sin(angle),
-            orbitalSpeed * cos(angle)
-        );
-        
-        float mass = massDist(gen);
-        float radius = radiusDist(gen);
-        sf::Color color(255, 255, 255);
-        
-        bodies.emplace_back(pos, vel, mass, radius, color);
+    : gravitationalConstant(g), softening(soften), timeStep(dt), width(w), height(h),
+      forceMethod(ForceMethod::Direct), theta(0.5f),
+      integrator(Integrator::Euler), accelerationsValid(false), velocityLag(-1.0f),
+      stepCount(0), forceEvaluations(0), reorderCount(0), reorderSeconds(0.0),
+      affinity(AffinityMode::None), pinnedThreads(0), bodiesPlaced(false), solver(nullptr),
+      initialBodyCount(0), indexOfIdValid(false), trajectory(nullptr),
+      kernelTiles{0, 0}, directMode(DirectSumMode::Symmetric) {
+    setBackend(defaultForceSolver());
+}
+
+void Simulation::initializeBodies(int n, const InitialConditions& conditions) {
+    initialConditions = conditions;
+    initialBodyCount = n;
+    generateBodies(conditions, n, gravitationalConstant, width, height, bodies, *solver);
+    accelerationsValid = false;
+    velocityLag = -1.0f;
+    indexOfIdValid = false;
+    stepLevel.clear();
+
+    // Generated by the static split, as placeBodies would copy them
+    bodiesPlaced = true;
+}
+
+void Simulation::insertBodies(const BodyStore& batch) {
+    if (batch.empty()) return;
+    const size_t capacity = bodies.x.capacity();
+    const uint32_t firstId = bodies.nextId;
+    bodies.append(batch);
+    if (!stepLevel.empty()) stepLevel.resize(bodies.size(), 0);
+
+    if (indexOfIdValid) {
+        indexOfId.resize(bodies.nextId, NO_BODY);
+        for (size_t k = 0; k < batch.size(); k++) {
+            indexOfId[firstId + k] = static_cast<uint32_t>(bodies.size() - batch.size() + k);
+        }
     }
+    // Only a reallocation moves the arrays off their first-touch placement
+    if (bodies.x.capacity() != capacity) bodiesPlaced = false;
+    accelerationsValid = false;
+}
+
+void Simulation::addBodies(int count) {
+    if (count <= 0) return;
+    generateMoreBodies(initialConditions, initialBodyCount, count, gravitationalConstant, width, height,
+                       insertBatch, bodies.nextId);
+    insertBodies(insertBatch);
+}
 
-    // Generate orbiting bodies (small)
-    for (int i = 0; i < n-1; i++) {
-        // Generate random angle and distance from center
-        std::uniform_real_distribution<float> angleDist(0.0f, 2.0f * M_PI);
-        std::uniform_real_distribution<float> distDist(50.0f, std::min(width, height)/2 - 50.0f);
-        std::uniform_real_distribution<float> massDist(20.0f, maxMassSmall);
-        std::uniform_real_distribution<float> radiusDist(0.5f, 1.5f);
-        std::uniform_int_distribution<int> colorDist(50, 255);
-        std::uniform_real_distribution<float> orbitTypeDist(0.7f, 1.0f);
-        
-        float angle = angleDist(gen);
-        float distance = distDist(gen);
-        float orbitFactor = orbitTypeDist(gen);
-        
-        // Calculate position based on angle and distance
-        sf::Vector2f pos(
-            width/2 + distance * cos(angle),
-            height/2 + distance * sin(angle)
-        );
-        
-        // Calculate orbital velocity for a circular orbit
-        // v = sqrt(G * M / r) perpendicular to radius vector
-        float baseOrbitalSpeed = sqrt(gravitationalConstant * massCentral / distance);
-        
-        float orbitalSpeed = baseOrbitalSpeed * orbitFactor;
-
-        // Velocity perpendicular to radius vector (for circular orbit)
-        sf::Vector2f vel(
-            -orbitalSpeed * sin(angle),
-            orbitalSpeed * cos(angle)
-        );
-        
-        float mass = massDist(gen);
-        float radius = radiusDist(gen);
-        sf::Color color(colorDist(gen), colorDist(gen), colorDist(gen));
-        sf::Color noColor(255, 255 ,255);
-        
-        bodies.emplace_back(pos, vel, mass, radius, color);
+void Simulation::buildIndexOfId() {
+    indexOfId.assign(bodies.nextId, NO_BODY);
+    for (size_t i = 0; i < bodies.size(); i++) {
+        indexOfId[bodies.id[i]] = static_cast<uint32_t>(i);
     }
+    indexOfIdValid = true;
 }
 
-void Simulation::update() {
-    // Reset all accelerations
-    for (auto& body : bodies) {
-        body.resetAcceleration();
+void Simulation::removeAt(size_t i) {
+    const uint32_t removed = bodies.id[i];
+    bodies.swapRemove(i);
+    if (i < stepLevel.size()) {
+        stepLevel[i] = stepLevel.back();
+        stepLevel.pop_back();
     }
-    
-    // Calculate forces between all pairs of bodies
-    for (size_t i = 0; i < bodies.size(); i++) {
-        for (size_t j = i + 1; j < bodies.size(); j++) {
-            sf::Vector2f pos_i = bodies[i].getPosition();
-            sf::Vector2f pos_j = bodies[j].getPosition();
-            
-            // Calculate distance vector
-            sf::Vector2f delta(pos_j.x - pos_i.x, pos_j.y - pos_i.y);
-            
-            // Calculate squared distance
-            float distSquared = delta.x * delta.x + delta.y * delta.y;
-            
-            // Add softening to prevent division by zero
-            distSquared += softening * softening;
-            
-            // Calculate gravitational force magnitude
-            // F = G * m1 * m2 / r^2
-            float forceMagnitude = gravitationalConstant * bodies[i].getMass() * bodies[j].getMass() / distSquared;
-            
-            // Calculate unit direction vector
-            float distance = sqrt(distSquared);
-            sf::Vector2f direction(delta.x / distance, delta.y / distance);
-            
-            // Calculate force vector
-            sf::Vector2f force(direction.x * forceMagnitude, direction.y * forceMagnitude);
-            
-            // Apply forces (Newton's third law: equal and opposite)
-            bodies[i].applyForce(force);
-            bodies[j].applyForce(sf::Vector2f(-force.x, -force.y));
-        }
+    indexOfId[removed] = NO_BODY;
+    if (i < bodies.size()) indexOfId[bodies.id[i]] = static_cast<uint32_t>(i);
+}
+
+size_t Simulation::removeBodies(const std::vector<uint32_t>& ids) {
+    if (!indexOfIdValid) buildIndexOfId();
+    size_t removed = 0;
+    for (uint32_t id : ids) {
+        if (id >= indexOfId.size() || indexOfId[id] == NO_BODY) continue;
+        removeAt(indexOfId[id]);
+        removed++;
+    }
+    if (removed > 0) accelerationsValid = false;
+    return removed;
+}
+
+size_t Simulation::removeNewestBodies(size_t count) {
+    if (!indexOfIdValid) buildIndexOfId();
+    size_t removed = 0;
+    while (removed < count && !bodies.empty()) {
+        // Trim the ids that are gone, so no later call walks past them again
+        while (indexOfId.back() == NO_BODY) indexOfId.pop_back();
+        removeAt(indexOfId.back());
+        removed++;
     }
-    
-    // Update positions and velocities
-    for (auto& body : bodies) {
-        body.update(timeStep);
+    if (removed > 0) accelerationsValid = false;
+    return removed;
+}
+
+bool Simulation::setBackend(const std::string& name) {
+    const std::string resolved = resolveForceSolverName(name);
+    if (resolved.empty()) return false;
+
+    solver = nullptr;
+    for (const std::unique_ptr<ForceSolver>& existing : solvers) {
+        if (resolved == existing->name()) solver = existing.get();
     }
+    if (!solver) {
+        solvers.push_back(createForceSolver(resolved));
+        solver = solvers.back().get();
+    }
+
+    // Other threads: pin them and place the arrays for their split again
+    pinnedThreads = 0;
+    bodiesPlaced = false;
+    return true;
+}
+
+void Simulation::setThreadCount(int threads) {
+    solver->setThreadCount(threads);
+    pinnedThreads = 0;
+    bodiesPlaced = false;
+}
+
+void Simulation::computeAccelerations(const BodyRangeFn& then) {
+    const ForceRequest request{bodies, gravitationalConstant, softening, forceMethod, theta,
+                               tree, mesh, kernelTiles, directMode};
+    solver->computeAccelerations(request, then);
 }
 
-const std::vector<Body>& Simulation::getBodies() const {
-    return bodies;
+BodyView Simulation::getBodies() const {
+    return BodyView(bodies);
 }
@@ -1,175 +0,0 @@
-#include "Simulation.h"
-#include <random>
-#include <cmath>
-#include <omp.h>
-
-Simulation::Simulation(float g, float soften, float dt, float w, float h)
-    : gravitationalConstant(g), softening(soften), timeStep(dt), width(w), height(h) {}
-
-void Simulation::initializeRandomBodies(int n, float maxMassSmall, float MaxMassBig) {
-    bodies.clear();
-
-    float massCentral = 50000.0f;
-        
-    // Add massive central body
-    bodies.emplace_back(
-        sf::Vector2f(width/2, height/2),       // Position at center
-        sf::Vector2f(0, 0),                    // No initial velocity
-        massCentral,                              // Very large mass
-        10.0f,                                 // Larger radius
-        sf::Color(255, 255, 255)                // Bright yellow/gold
-    );
-
-   
-    // Random number generation
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    
-    // Generate orbiting bodies (big)
-    for (int i = 0; i <  n / 50; i++) {
-        // Generate random angle and distance from center
-        std::uniform_real_distribution<float> angleDist(0.0f, 2.0f * M_PI);
-        std::uniform_real_distribution<float> distDist(250.0f, std::min(width, height)/2 - 50.0f);
-        std::uniform_real_distribution<float> massDist(1000.0f, MaxMassBig);
-        std::uniform_real_distribution<float> radiusDist(4.0f, 9.0f);
-        std::uniform_real_distribution<float> orbitTypeDist(0.7f, 1.0f);
-        
-        float angle = angleDist(gen);
-        float distance = distDist(gen);
-        float orbitFactor = orbitTypeDist(gen);
-        
-        // Calculate position based on angle and distance
-        sf::Vector2f pos(
-            width/2 + distance * cos(angle),
-            height/2 + distance * sin(angle)
-        );
-        
-        // Calculate orbital velocity for a circular orbit
-        float baseOrbitalSpeed = sqrt(gravitationalConstant * massCentral / distance);
-        
-        float orbitalSpeed = baseOrbitalSpeed * orbitFactor;
-        
-        // Velocity perpendicular to radius vector (for circular orbit)
-        sf::Vector2f vel(
-            -orbitalSpeed * sin(angle),
-            orbitalSpeed * cos(angle)
-        );
-        
-        float mass = massDist(gen);
-        float radius = radiusDist(gen);
-        sf::Color color(255, 255, 255);
-        
-        bodies.emplace_back(pos, vel, mass, radius, color);
-    }
-
-    // Generate orbiting bodies (small)
-    for (int i = 0; i < n-1; i++) {
-        // Generate random angle and distance from center
-        std::uniform_real_distribution<float> angleDist(0.0f, 2.0f * M_PI);
-        std::uniform_real_distribution<float> distDist(50.0f, std::min(width, height)/2 - 50.0f);
-        std::uniform_real_distribution<float> massDist(20.0f, maxMassSmall);
-        std::uniform_real_distribution<float> radiusDist(0.5f, 1.5f);
-        std::uniform_int_distribution<int> colorDist(50, 255);
-        std::uniform_real_distribution<float> orbitTypeDist(0.7f, 1.0f);
-        
-        float angle = angleDist(gen);
-        float distance = distDist(gen);
-        float orbitFactor = orbitTypeDist(gen);
-        
-        // Calculate position based on angle and distance
-        sf::Vector2f pos(
-            width/2 + distance * cos(angle),
-            height/2 + distance * sin(angle)
-        );
-        
-        // Calculate orbital velocity for a circular orbit
-        // v = sqrt(G * M / r) perpendicular to radius vector
-        float baseOrbitalSpeed = sqrt(gravitationalConstant * massCentral / distance);
-        
-        float orbitalSpeed = baseOrbitalSpeed * orbitFactor;
-
-        // Velocity perpendicular to radius vector (for circular orbit)
-        sf::Vector2f vel(
-            -orbitalSpeed * sin(angle),
-            orbitalSpeed * cos(angle)
-        );
-        
-        float mass = massDist(gen);
-        float radius = radiusDist(gen);
-        sf::Color color(colorDist(gen), colorDist(gen), colorDist(gen));
-        sf::Color noColor(255, 255 ,255);
-        
-        bodies.emplace_back(pos, vel, mass, radius, color);
-    }
-}
-
-void Simulation::update() {
-    const size_t n = bodies.size();
-    
-    // Reset all accelerations
-    #pragma omp parallel for
-    for (size_t i = 0; i < n; i++) {
-        bodies[i].resetAcceleration();
-    }
-    
-    // Create force arrays for reduction
-    std::vector<std::vector<sf::Vector2f>> thread_forces;
-    int num_threads;
-    
-    #pragma omp parallel
-    {
-        #pragma omp single
-        {
-            num_threads = omp_get_num_threads();
-            thread_forces.resize(num_threads, std::vector<sf::Vector2f>(n, sf::Vector2f(0.0f, 0.0f)));
-        }
-        
-        int thread_id = omp_get_thread_num();
-        
-        #pragma omp for schedule(dynamic) nowait
-        for (size_t i = 0; i < n; i++) {
-            sf::Vector2f pos_i = bodies[i].getPosition();
-            float mass_i = bodies[i].getMass();
-            
-            for (size_t j = i + 1; j < n; j++) {
-                sf::Vector2f pos_j = bodies[j].getPosition();
-                float mass_j = bodies[j].getMass();
-                
-                // Calculate distance vector
-                sf::Vector2f delta(pos_j.x - pos_i.x, pos_j.y - pos_i.y);
-                
-                // Calculate squared distance with softening
-                float distSquared = delta.x * delta.x + delta.y * delta.y + softening * softening;
-                
-                // Calculate gravitational force magnitude
-                float forceMagnitude = gravitationalConstant * mass_i * mass_j / distSquared;
-                
-                // Calculate unit direction vector and force
-                float invDistance = 1.0f / sqrt(distSquared);
-                sf::Vector2f force(delta.x * forceMagnitude * invDistance, delta.y * forceMagnitude * invDistance);
-                
-                // Accumulate forces in thread-local arrays
-                thread_forces[thread_id][i].x += force.x;
-                thread_forces[thread_id][i].y += force.y;
-                thread_forces[thread_id][j].x -= force.x;
-                thread_forces[thread_id][j].y -= force.y;
-            }
-        }
-    }
-    
-    // Reduce all thread forces and apply to bodies
-    #pragma omp parallel for
-    for (size_t i = 0; i < n; i++) {
-        sf::Vector2f total_force(0.0f, 0.0f);
-        for (int t = 0; t < num_threads; t++) {
-            total_force.x += thread_forces[t][i].x;
-            total_force.y += thread_forces[t][i].y;
-        }
-        bodies[i].applyForce(total_force);
-        bodies[i].update(timeStep);
-    }
-}
-
-const std::vector<Body>& Simulation::getBodies() const {
-    return bodies;
-}
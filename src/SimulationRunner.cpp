@@ -0,0 +1,102 @@
+#include "SimulationRunner.h"
+#include "Simulation.h"
+#include "Profiler.h"
+#include <chrono>
+
+SimulationRunner::SimulationRunner(Simulation& sim, float maxStepsPerSecond)
+    : simulation(sim), running(false), stepRateLimit(maxStepsPerSecond),
+      stepsPerSecond(0.0), stepsTaken(0) {}
+
+SimulationRunner::~SimulationRunner() {
+    stop();
+}
+
+void SimulationRunner::start() {
+    if (running) return;
+
+    // The first snapshot is ready before the render loop asks for one
+    publish();
+    snapshots.update();
+
+    running = true;
+    thread = std::thread(&SimulationRunner::run, this);
+}
+
+void SimulationRunner::stop() {
+    running = false;
+    if (thread.joinable()) thread.join();
+}
+
+void SimulationRunner::post(Command command) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(std::move(command));
+}
+
+void SimulationRunner::runCommands() {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        if (commands.empty()) return;
+        executing.swap(commands);
+    }
+
+    // Run outside the lock so posting never waits on a slow command
+    PROFILE_SCOPE("commands");
+    for (Command& command : executing) {
+        command(simulation);
+    }
+    executing.clear();
+}
+
+void SimulationRunner::publish() {
+    PROFILE_SCOPE("publish");
+    const BodyStore& store = simulation.getStore();
+    BodySnapshot& snapshot = snapshots.writeBuffer();
+
+    snapshot.x.assign(store.x.begin(), store.x.end());
+    snapshot.y.assign(store.y.begin(), store.y.end());
+    snapshot.radius.assign(store.radius.begin(), store.radius.end());
+    snapshot.color.assign(store.color.begin(), store.color.end());
+    snapshot.step = stepsTaken.load(std::memory_order_relaxed);
+
+    snapshots.publish();
+}
+
+void SimulationRunner::run() {
+    using Clock = std::chrono::steady_clock;
+    Profiler::setThreadName("simulation");
+
+    const Clock::duration minimumStep = stepRateLimit > 0.0f
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / stepRateLimit))
+        : Clock::duration::zero();
+
+    Clock::time_point windowStart = Clock::now();
+    Clock::time_point nextStep = windowStart;
+    uint64_t windowSteps = 0;
+
+    while (running) {
+        runCommands();
+
+        Clock::time_point stepStart = Clock::now();
+        simulation.update();
+        Clock::time_point stepEnd = Clock::now();
+        stepsTaken.fetch_add(1, std::memory_order_relaxed);
+        if (stepObserver) stepObserver(std::chrono::duration<double>(stepEnd - stepStart).count());
+        publish();
+
+        // Steps per second over half-second windows
+        windowSteps++;
+        Clock::time_point now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - windowStart).count();
+        if (elapsed >= 0.5) {
+            stepsPerSecond.store(windowSteps / elapsed, std::memory_order_relaxed);
+            windowStart = now;
+            windowSteps = 0;
+        }
+
+        if (minimumStep > Clock::duration::zero()) {
+            nextStep += minimumStep;
+            if (nextStep < now) nextStep = now;
+            std::this_thread::sleep_until(nextStep);
+        }
+    }
+}
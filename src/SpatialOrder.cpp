@@ -0,0 +1,101 @@
+#include "SpatialOrder.h"
+#include <algorithm>
+
+const char* curveName(SpaceFillingCurve curve) {
+    switch (curve) {
+        case SpaceFillingCurve::None: return "none";
+        case SpaceFillingCurve::Morton: return "morton";
+        case SpaceFillingCurve::Hilbert: return "hilbert";
+    }
+    return "unknown";
+}
+
+bool parseCurve(const std::string& name, SpaceFillingCurve& curve) {
+    if (name == "none" || name == "off") {
+        curve = SpaceFillingCurve::None;
+    } else if (name == "morton" || name == "z") {
+        curve = SpaceFillingCurve::Morton;
+    } else if (name == "hilbert") {
+        curve = SpaceFillingCurve::Hilbert;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+const int CURVE_BITS = 16;
+
+// Spread the low 16 bits of v to the even bit positions
+uint32_t spreadBits(uint32_t v) {
+    v &= 0xFFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+} // namespace
+
+uint32_t mortonKey(uint32_t x, uint32_t y) {
+    return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+uint32_t hilbertKey(uint32_t x, uint32_t y) {
+    const uint32_t side = 1u << CURVE_BITS;
+    uint32_t key = 0;
+    for (uint32_t s = side >> 1; s > 0; s >>= 1) {
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        key += s * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant so the curve inside it starts where the last one ended
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return key;
+}
+
+void spatialOrder(const float* x, const float* y, size_t n, SpaceFillingCurve curve,
+                  std::vector<uint32_t>& order) {
+    order.resize(n);
+    if (n == 0) return;
+
+    float minX = x[0], maxX = x[0];
+    float minY = y[0], maxY = y[0];
+    for (size_t i = 1; i < n; i++) {
+        minX = std::min(minX, x[i]);
+        maxX = std::max(maxX, x[i]);
+        minY = std::min(minY, y[i]);
+        maxY = std::max(maxY, y[i]);
+    }
+
+    // Square grid of 2^16 cells per side over the bounding box
+    const float extent = std::max(maxX - minX, maxY - minY);
+    const float maxCell = static_cast<float>((1u << CURVE_BITS) - 1);
+    const float scale = extent > 0.0f ? maxCell / extent : 0.0f;
+    auto cell = [&](float v, float origin) {
+        return static_cast<uint32_t>(std::min(std::max((v - origin) * scale, 0.0f), maxCell));
+    };
+
+    // Key in the high half, index in the low half: one sort moves both
+    std::vector<uint64_t> keyed(n);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t cx = cell(x[i], minX);
+        uint32_t cy = cell(y[i], minY);
+        uint32_t key = (curve == SpaceFillingCurve::Hilbert) ? hilbertKey(cx, cy) : mortonKey(cx, cy);
+        keyed[i] = (static_cast<uint64_t>(key) << 32) | static_cast<uint32_t>(i);
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    for (size_t k = 0; k < n; k++) {
+        order[k] = static_cast<uint32_t>(keyed[k]);
+    }
+}
@@ -0,0 +1,214 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+// Spin rounds before an idle worker sleeps: long enough to bridge the serial
+// gaps between the loops of one step, yielding now and then in case the
+// machine is oversubscribed
+const int SPIN_ROUNDS = 1 << 14;
+
+// Chunks per worker: enough for stealing to even out uneven chunks
+const size_t CHUNKS_PER_WORKER = 8;
+const size_t DEFAULT_GRAIN = 256;
+
+thread_local int workerIndex = 0;
+
+inline void cpuRelax(int spin) {
+    if ((spin & 63) == 63) {
+        std::this_thread::yield();
+        return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+inline uint64_t packRange(uint32_t next, uint32_t end) { return (static_cast<uint64_t>(end) << 32) | next; }
+inline uint32_t rangeNext(uint64_t range) { return static_cast<uint32_t>(range); }
+inline uint32_t rangeEnd(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+
+} // namespace
+
+ThreadPool::ThreadPool(int threads)
+    : threadCount(0), loopCount(0), epoch(0), pending(0), sleepers(0), stopping(false) {
+    start(threads);
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+int ThreadPool::defaultSize() {
+    if (const char* env = std::getenv("NBODY_THREADS")) {
+        try {
+            int threads = std::stoi(env);
+            if (threads > 0) return threads;
+        } catch (const std::exception&) {
+        }
+    }
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+void ThreadPool::resize(int threads) {
+    stop();
+    start(threads);
+}
+
+int ThreadPool::currentWorker() {
+    return workerIndex;
+}
+
+uint64_t ThreadPool::getStealCount() const {
+    uint64_t steals = 0;
+    for (int w = 0; w < threadCount; w++) steals += slots[w].steals;
+    return steals;
+}
+
+void ThreadPool::start(int threads) {
+    threadCount = std::max(1, threads);
+    slots.reset(new Slot[threadCount]);
+    stopping.store(false);
+    for (int w = 1; w < threadCount; w++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, w, epoch.load());
+    }
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        stopping.store(true);
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+}
+
+void ThreadPool::run(size_t n, size_t grain, ChunkFn fn, void* context) {
+    if (n == 0) return;
+    const size_t parts = static_cast<size_t>(threadCount) * CHUNKS_PER_WORKER;
+    const size_t chunkSize = std::max(grain > 0 ? grain : DEFAULT_GRAIN, (n + parts - 1) / parts);
+
+    // Too little work to split: run it here without waking anyone
+    if (threadCount == 1 || n <= chunkSize) {
+        fn(context, 0, n);
+        return;
+    }
+
+    job = Job{fn, context, n, chunkSize, false};
+    const size_t chunks = (n + chunkSize - 1) / chunkSize;
+    for (int w = 0; w < threadCount; w++) {
+        slots[w].range.store(packRange(static_cast<uint32_t>(chunks * w / threadCount),
+                                       static_cast<uint32_t>(chunks * (w + 1) / threadCount)),
+                             std::memory_order_relaxed);
+    }
+    dispatch();
+}
+
+void ThreadPool::forEachWorker(const std::function<void(int)>& fn) {
+    if (threadCount == 1) {
+        fn(0);
+        return;
+    }
+
+    auto body = [&fn](size_t worker, size_t) { fn(static_cast<int>(worker)); };
+    using Body = decltype(body);
+    job = Job{[](void* context, size_t begin, size_t end) { (*static_cast<Body*>(context))(begin, end); },
+              &body, static_cast<size_t>(threadCount), 1, true};
+    for (int w = 0; w < threadCount; w++) {
+        slots[w].range.store(packRange(w, w + 1), std::memory_order_relaxed);
+    }
+    dispatch();
+}
+
+void ThreadPool::dispatch() {
+    loopCount++;
+    pending.store(threadCount - 1, std::memory_order_relaxed);
+    epoch.fetch_add(1);
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        wake.notify_all();
+    }
+
+    work(0);
+
+    // Wait until every worker has left the loop, so none of them still reads
+    // this job or its slots when the next loop is set up
+    for (int spin = 0; pending.load(std::memory_order_acquire) > 0; spin++) {
+        cpuRelax(spin);
+    }
+}
+
+void ThreadPool::workerLoop(int worker, uint64_t seen) {
+    workerIndex = worker;
+    for (;;) {
+        for (int spin = 0; spin < SPIN_ROUNDS; spin++) {
+            if (epoch.load(std::memory_order_acquire) != seen || stopping.load()) break;
+            cpuRelax(spin);
+        }
+        if (epoch.load(std::memory_order_acquire) == seen && !stopping.load()) {
+            std::unique_lock<std::mutex> lock(wakeLock);
+            sleepers.fetch_add(1);
+            wake.wait(lock, [&] { return epoch.load() != seen || stopping.load(); });
+            sleepers.fetch_sub(1);
+        }
+        if (stopping.load()) return;
+
+        seen = epoch.load(std::memory_order_acquire);
+        work(worker);
+        pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void ThreadPool::work(int worker) {
+    uint32_t chunk;
+    for (;;) {
+        if (popOwn(slots[worker], chunk) || (!job.perWorker && steal(worker, chunk))) {
+            execute(chunk);
+        } else {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::popOwn(Slot& slot, uint32_t& chunk) {
+    uint64_t range = slot.range.load(std::memory_order_acquire);
+    while (rangeNext(range) < rangeEnd(range)) {
+        if (slot.range.compare_exchange_weak(range, packRange(rangeNext(range) + 1, rangeEnd(range)),
+                                             std::memory_order_acq_rel)) {
+            chunk = rangeNext(range);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::steal(int worker, uint32_t& chunk) {
+    // Only the owner ever refills a slot, and it drains it before leaving
+    // the loop, so a chunk can never be stranded in an abandoned slot
+    for (int k = 1; k < threadCount; k++) {
+        Slot& victim = slots[(worker + k) % threadCount];
+        uint64_t range = victim.range.load(std::memory_order_acquire);
+        while (rangeNext(range) < rangeEnd(range)) {
+            const uint32_t next = rangeNext(range);
+            const uint32_t end = rangeEnd(range);
+            const uint32_t mid = next + (end - next) / 2;
+            if (victim.range.compare_exchange_weak(range, packRange(next, mid), std::memory_order_acq_rel)) {
+                // Run the first stolen chunk, keep the rest for stealing in turn
+                chunk = mid;
+                slots[worker].range.store(packRange(mid + 1, end), std::memory_order_release);
+                slots[worker].steals++;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::execute(uint32_t chunk) {
+    const size_t begin = static_cast<size_t>(chunk) * job.chunkSize;
+    const size_t end = std::min(job.n, begin + job.chunkSize);
+    job.fn(job.context, begin, end);
+}
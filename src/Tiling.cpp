@@ -0,0 +1,45 @@
+#include "Tiling.h"
+#include <algorithm>
+
+void TriangularTiling::build(size_t n, size_t block) {
+    block = std::max<size_t>(1, block);
+    if (n == bodyCount && block == blockSize && !tiles.empty()) return;
+
+    bodyCount = n;
+    blockSize = block;
+    tiles.clear();
+    workPrefix.assign(1, 0);
+
+    const size_t blocks = (n + block - 1) / block;
+    for (size_t I = 0; I < blocks; I++) {
+        const uint32_t iBegin = static_cast<uint32_t>(I * block);
+        const uint32_t iEnd = static_cast<uint32_t>(std::min(n, (I + 1) * block));
+        for (size_t J = I; J < blocks; J++) {
+            const uint32_t jBegin = static_cast<uint32_t>(J * block);
+            const uint32_t jEnd = static_cast<uint32_t>(std::min(n, (J + 1) * block));
+
+            // Diagonal tiles only hold the upper triangle of their square
+            const uint64_t rows = iEnd - iBegin;
+            const uint64_t pairs = (I == J) ? rows * (rows - 1) / 2
+                                            : rows * static_cast<uint64_t>(jEnd - jBegin);
+
+            tiles.push_back({iBegin, iEnd, jBegin, jEnd});
+            workPrefix.push_back(workPrefix.back() + pairs);
+        }
+    }
+}
+
+std::pair<size_t, size_t> TriangularTiling::range(size_t part, size_t parts) const {
+    if (tiles.empty() || parts == 0) return {0, 0};
+
+    // Find the first tile whose cumulative work reaches the part's share
+    const uint64_t total = workPrefix.back();
+    auto boundary = [&](size_t p) -> size_t {
+        if (p == 0) return 0;
+        if (p >= parts) return tiles.size();
+        const uint64_t target = total * p / parts;
+        return static_cast<size_t>(std::lower_bound(workPrefix.begin(), workPrefix.end(), target) -
+                                   workPrefix.begin());
+    };
+    return {boundary(part), boundary(part + 1)};
+}
@@ -0,0 +1,463 @@
+#include "Trajectory.h"
+#include "Simulation.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+const char MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'T', 'R', 'J'};
+const char FRAME_TAG[4] = {'F', 'R', 'M', 'E'};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Raw size of one body: id, x, y, vx, vy
+const uint64_t RAW_BODY_BYTES = 5 * 4;
+
+template <typename T>
+void append(std::vector<uint8_t>& out, const T* values, size_t count) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values);
+    out.insert(out.end(), bytes, bytes + count * sizeof(T));
+}
+
+void appendVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Small magnitudes of either sign to small unsigned values
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Bounds-checked cursor over a frame's payload
+struct PayloadReader {
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+    bool failed = false;
+
+    template <typename T>
+    void read(T* values, size_t count) {
+        const size_t bytes = count * sizeof(T);
+        if (failed || size - position < bytes) {
+            failed = true;
+            return;
+        }
+        std::memcpy(values, data + position, bytes);
+        position += bytes;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (position >= size) break;
+            const uint8_t byte = data[position++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        failed = true;
+        return 0;
+    }
+};
+
+const std::vector<float>& frameArray(const TrajectoryFrame& frame, int which) {
+    switch (which) {
+        case 0: return frame.x;
+        case 1: return frame.y;
+        case 2: return frame.vx;
+        default: return frame.vy;
+    }
+}
+
+std::vector<float>& frameArray(TrajectoryFrame& frame, int which) {
+    return const_cast<std::vector<float>&>(frameArray(static_cast<const TrajectoryFrame&>(frame), which));
+}
+
+// Indices of the bodies in id order. Ids are normally a permutation of
+// 0..n-1 and are placed directly; anything else is sorted.
+void idOrder(const std::vector<uint32_t>& id, std::vector<uint32_t>& order) {
+    const size_t n = id.size();
+    order.assign(n, UINT32_MAX);
+    bool permutation = true;
+    for (size_t i = 0; i < n && permutation; i++) {
+        permutation = id[i] < n && order[id[i]] == UINT32_MAX;
+        if (permutation) order[id[i]] = static_cast<uint32_t>(i);
+    }
+    if (permutation) return;
+
+    for (size_t i = 0; i < n; i++) order[i] = static_cast<uint32_t>(i);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return id[a] < id[b]; });
+}
+
+} // namespace
+
+const char* trajectoryEncodingName(TrajectoryEncoding encoding) {
+    switch (encoding) {
+        case TrajectoryEncoding::Raw: return "raw";
+        case TrajectoryEncoding::Quantized: return "quantized";
+        case TrajectoryEncoding::Delta: return "delta";
+    }
+    return "unknown";
+}
+
+bool parseTrajectoryEncoding(const std::string& name, TrajectoryEncoding& encoding) {
+    if (name == "raw") {
+        encoding = TrajectoryEncoding::Raw;
+    } else if (name == "quantized" || name == "q16") {
+        encoding = TrajectoryEncoding::Quantized;
+    } else if (name == "delta") {
+        encoding = TrajectoryEncoding::Delta;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void TrajectoryFrame::resize(std::size_t n) {
+    id.resize(n);
+    x.resize(n);
+    y.resize(n);
+    vx.resize(n);
+    vy.resize(n);
+}
+
+TrajectoryWriter::TrajectoryWriter()
+    : head(0), tail(0), stopping(false), framesWritten(0), framesDropped(0), bytesWritten(0),
+      rawBytes(0), framesSinceKeyframe(0) {}
+
+TrajectoryWriter::~TrajectoryWriter() {
+    close();
+}
+
+bool TrajectoryWriter::open(const std::string& filePath, const TrajectorySettings& trajectorySettings,
+                            std::string& error) {
+    close();
+    settings = trajectorySettings;
+    settings.interval = std::max(1, settings.interval);
+    settings.keyframeInterval = std::max(1, settings.keyframeInterval);
+    settings.bufferFrames = std::max(2, settings.bufferFrames);
+    if (!(settings.precision > 0.0f)) settings.precision = 1e-3f;
+
+    file.open(filePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        error = "could not open " + filePath + " for writing";
+        return false;
+    }
+    path = filePath;
+
+    TrajectoryFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = TRAJECTORY_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.encoding = static_cast<uint32_t>(settings.encoding);
+    header.interval = static_cast<uint32_t>(settings.interval);
+    header.precision = settings.precision;
+    header.keyframeInterval = static_cast<uint32_t>(settings.keyframeInterval);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Slots keep their capacity between frames, so a steady run allocates
+    // only while the first few frames are filled
+    ring.assign(settings.bufferFrames, TrajectoryFrame());
+    head = 0;
+    tail = 0;
+    stopping = false;
+    framesWritten = 0;
+    framesDropped = 0;
+    bytesWritten = sizeof(header);
+    rawBytes = sizeof(header);
+    keyIds.clear();
+    framesSinceKeyframe = 0;
+
+    worker = std::thread(&TrajectoryWriter::run, this);
+    return true;
+}
+
+void TrajectoryWriter::close() {
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> guard(wakeLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+    file.close();
+
+    const std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Trajectory saved: " << framesWritten << " frames";
+    if (framesDropped > 0) std::cout << " (" << framesDropped << " dropped, writer behind)";
+    std::cout << ", " << bytesWritten / 1e6 << " MB, " << trajectoryEncodingName(settings.encoding)
+              << " at " << 100.0 * bytesWritten / std::max<uint64_t>(1, rawBytes) << "% of raw, "
+              << path << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+    if (!file) std::cerr << "Error: Writing " << path << " failed." << std::endl;
+}
+
+TrajectoryFrame* TrajectoryWriter::acquire() {
+    const uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= ring.size()) {
+        framesDropped++;
+        return nullptr;
+    }
+    return &ring[h % ring.size()];
+}
+
+void TrajectoryWriter::publish() {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    // The lock is only held to check for work, never while writing
+    { std::lock_guard<std::mutex> guard(wakeLock); }
+    wake.notify_one();
+}
+
+void TrajectoryWriter::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(wakeLock);
+            wake.wait(guard, [this]() {
+                return stopping || tail.load(std::memory_order_relaxed) != head.load(std::memory_order_acquire);
+            });
+        }
+
+        // Queued frames are written before the thread stops
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        const uint64_t h = head.load(std::memory_order_acquire);
+        if (t == h) return;
+        for (; t < h; t++) {
+            writeFrame(ring[t % ring.size()]);
+            tail.store(t + 1, std::memory_order_release);
+        }
+    }
+}
+
+void TrajectoryWriter::writeFrame(const TrajectoryFrame& frame) {
+    idOrder(frame.id, order);
+    payload.clear();
+
+    uint32_t flags = 0;
+    switch (settings.encoding) {
+        case TrajectoryEncoding::Raw: flags = encodeRaw(frame); break;
+        case TrajectoryEncoding::Quantized: flags = encodeQuantized(frame); break;
+        case TrajectoryEncoding::Delta: flags = encodeDelta(frame); break;
+    }
+
+    TrajectoryFrameHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.tag, FRAME_TAG, sizeof(FRAME_TAG));
+    header.flags = flags;
+    header.step = frame.step;
+    header.timeStep = frame.timeStep;
+    header.bodyCount = static_cast<uint32_t>(frame.size());
+    header.payloadBytes = payload.size();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+    framesWritten++;
+    bytesWritten += sizeof(header) + payload.size();
+    rawBytes += sizeof(header) + frame.size() * RAW_BODY_BYTES;
+}
+
+uint32_t TrajectoryWriter::encodeRaw(const TrajectoryFrame& frame) {
+    const size_t n = frame.size();
+    payload.reserve(n * RAW_BODY_BYTES);
+    for (size_t k = 0; k < n; k++) append(payload, &frame.id[order[k]], 1);
+    for (int a = 0; a < 4; a++) {
+        const std::vector<float>& values = frameArray(frame, a);
+        for (size_t k = 0; k < n; k++) append(payload, &values[order[k]], 1);
+    }
+    return 0;
+}
+
+uint32_t TrajectoryWriter::encodeQuantized(const TrajectoryFrame& frame) {
+    const size_t n = frame.size();
+    payload.reserve(n * 12 + 32);
+    for (size_t k = 0; k < n; k++) append(payload, &frame.id[order[k]], 1);
+
+    for (int a = 0; a < 4; a++) {
+        const std::vector<float>& values = frameArray(frame, a);
+        float low = 0.0f, high = 0.0f;
+        if (n > 0) {
+            auto range = std::minmax_element(values.begin(), values.end());
+            low = *range.first;
+            high = *range.second;
+        }
+        const float scale = (high > low) ? (high - low) / 65535.0f : 0.0f;
+        const float inverse = (scale > 0.0f) ? 1.0f / scale : 0.0f;
+        append(payload, &low, 1);
+        append(payload, &scale, 1);
+        for (size_t k = 0; k < n; k++) {
+            const float q = std::round((values[order[k]] - low) * inverse);
+            const uint16_t stored = static_cast<uint16_t>(std::min(65535.0f, std::max(0.0f, q)));
+            append(payload, &stored, 1);
+        }
+    }
+    return 0;
+}
+
+uint32_t TrajectoryWriter::encodeDelta(const TrajectoryFrame& frame) {
+    const size_t n = frame.size();
+    const double inverse = 1.0 / settings.precision;
+
+    // A new keyframe on schedule and whenever bodies came or went
+    bool keyframe = framesSinceKeyframe == 0 || keyIds.size() != n ||
+                    framesSinceKeyframe >= static_cast<uint64_t>(settings.keyframeInterval);
+    for (size_t k = 0; k < n && !keyframe; k++) keyframe = keyIds[k] != frame.id[order[k]];
+
+    if (keyframe) {
+        keyIds.resize(n);
+        uint32_t last = 0;
+        for (size_t k = 0; k < n; k++) {
+            keyIds[k] = frame.id[order[k]];
+            appendVarint(payload, keyIds[k] - last);
+            last = keyIds[k];
+        }
+        framesSinceKeyframe = 0;
+    }
+
+    for (int a = 0; a < 4; a++) {
+        const std::vector<float>& values = frameArray(frame, a);
+        std::vector<int64_t>& last = previous[a];
+        if (keyframe) last.assign(n, 0);
+        for (size_t k = 0; k < n; k++) {
+            const int64_t q = std::llround(values[order[k]] * inverse);
+            appendVarint(payload, zigzag(q - last[k]));
+            last[k] = q;
+        }
+    }
+    framesSinceKeyframe++;
+    return keyframe ? static_cast<uint32_t>(FrameKeyframe) : 0u;
+}
+
+bool TrajectoryReader::open(const std::string& filePath, std::string& error) {
+    file.open(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        error = "could not open " + filePath;
+        return false;
+    }
+    file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
+    if (!file || std::memcmp(fileHeader.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = filePath + " is not a trajectory";
+    } else if (fileHeader.byteOrder != BYTE_ORDER_MARK) {
+        error = filePath + " was written on a machine with another byte order";
+    } else if (fileHeader.version != TRAJECTORY_VERSION) {
+        error = filePath + " has trajectory version " + std::to_string(fileHeader.version) +
+                ", expected " + std::to_string(TRAJECTORY_VERSION);
+    } else if (fileHeader.encoding > static_cast<uint32_t>(TrajectoryEncoding::Delta)) {
+        error = filePath + " uses an unknown encoding";
+    } else {
+        return true;
+    }
+    file.close();
+    return false;
+}
+
+bool TrajectoryReader::next(TrajectoryFrame& frame, std::string& error) {
+    error.clear();
+    TrajectoryFrameHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (file.gcount() == 0) return false;
+    if (!file || std::memcmp(header.tag, FRAME_TAG, sizeof(FRAME_TAG)) != 0) {
+        error = "damaged frame header";
+        return false;
+    }
+    payload.resize(header.payloadBytes);
+    file.read(reinterpret_cast<char*>(payload.data()), payload.size());
+    if (!file) {
+        error = "truncated frame at step " + std::to_string(header.step);
+        return false;
+    }
+
+    const size_t n = header.bodyCount;
+    frame.step = header.step;
+    frame.timeStep = header.timeStep;
+    frame.resize(n);
+    PayloadReader in{payload.data(), payload.size()};
+
+    switch (static_cast<TrajectoryEncoding>(fileHeader.encoding)) {
+        case TrajectoryEncoding::Raw:
+            in.read(frame.id.data(), n);
+            for (int a = 0; a < 4; a++) in.read(frameArray(frame, a).data(), n);
+            break;
+
+        case TrajectoryEncoding::Quantized:
+            in.read(frame.id.data(), n);
+            for (int a = 0; a < 4; a++) {
+                float low = 0.0f, scale = 0.0f;
+                in.read(&low, 1);
+                in.read(&scale, 1);
+                std::vector<float>& values = frameArray(frame, a);
+                for (size_t k = 0; k < n && !in.failed; k++) {
+                    uint16_t q = 0;
+                    in.read(&q, 1);
+                    values[k] = low + scale * q;
+                }
+            }
+            break;
+
+        case TrajectoryEncoding::Delta: {
+            const bool keyframe = header.flags & FrameKeyframe;
+            if (keyframe) {
+                keyIds.resize(n);
+                uint32_t last = 0;
+                for (size_t k = 0; k < n; k++) {
+                    last += static_cast<uint32_t>(in.varint());
+                    keyIds[k] = last;
+                }
+            } else if (keyIds.size() != n) {
+                error = "frame at step " + std::to_string(header.step) + " has no keyframe before it";
+                return false;
+            }
+            frame.id = keyIds;
+            for (int a = 0; a < 4; a++) {
+                std::vector<int64_t>& last = previous[a];
+                if (keyframe) last.assign(n, 0);
+                std::vector<float>& values = frameArray(frame, a);
+                for (size_t k = 0; k < n; k++) {
+                    last[k] += unzigzag(in.varint());
+                    values[k] = static_cast<float>(last[k] * static_cast<double>(fileHeader.precision));
+                }
+            }
+            break;
+        }
+    }
+
+    if (in.failed || in.position != in.size) {
+        error = "corrupt payload at step " + std::to_string(header.step);
+        return false;
+    }
+    return true;
+}
+
+void Simulation::recordTrajectory() {
+    // A full ring drops the frame instead of waiting for the disk
+    TrajectoryFrame* frame = trajectory->acquire();
+    if (!frame) return;
+
+    PROFILE_SCOPE("trajectory copy");
+    const size_t n = bodies.size();
+    frame->step = stepCount;
+    frame->timeStep = timeStep;
+    frame->resize(n);
+
+    // Copied by the threads that own the ranges, while they are in their caches
+    solver->forEachRange(n, [&](size_t begin, size_t end) {
+        const size_t count = end - begin;
+        std::memcpy(frame->x.data() + begin, bodies.x.data() + begin, count * sizeof(float));
+        std::memcpy(frame->y.data() + begin, bodies.y.data() + begin, count * sizeof(float));
+        std::memcpy(frame->vx.data() + begin, bodies.vx.data() + begin, count * sizeof(float));
+        std::memcpy(frame->vy.data() + begin, bodies.vy.data() + begin, count * sizeof(float));
+        std::memcpy(frame->id.data() + begin, bodies.id.data() + begin, count * sizeof(uint32_t));
+    });
+    trajectory->publish();
+}
@@ -2,69 +2,305 @@
 #include <iostream>
 #include <signal.h>
 #include <atomic>
+#include <vector>
 #include "Simulation.h"
 #include "Extra.h"
 #include "Benchmark.hpp"
+#include "ForceKernel.h"
+#include "SimulationRunner.h"
+#include "BodyRenderer.h"
+#include "Profiler.h"
 
 // Global variables for signal handling
 std::atomic<bool> shouldExit(false);
-Benchmark* globalBenchmark = nullptr;
 
+// The main loop saves the results once the simulation thread has stopped
 void signalHandler(int signum) {
     std::cout << "\nReceived shutdown signal. Saving results..." << std::endl;
-    if (globalBenchmark) {
-        globalBenchmark->saveResults();
-    }
     shouldExit = true;
 }
 
-std::string detectImplementation(const std::string& binaryPath) {
-    // Extract just the filename from the full path
-    size_t lastSlash = binaryPath.find_last_of("/\\");
-    std::string filename = (lastSlash != std::string::npos) ? 
-                          binaryPath.substr(lastSlash + 1) : binaryPath;
-    
-    // Check if filename contains implementation indicators
-    if (filename.find("omp") != std::string::npos || 
-        filename.find("OpenMP") != std::string::npos ||
-        filename.find("openmp") != std::string::npos) {
-        return "OpenMP";
-    } else if (filename.find("serial") != std::string::npos ||
-               filename.find("Serial") != std::string::npos) {
-        return "Serial";
-    } else {
-        // Default fallback - you can change this based on your preference
-        return "Unknown";
-    }
+// Configuration a result row is labelled with, as the simulation runs now
+Benchmark::Metadata metadataOf(const Simulation& simulation) {
+    Benchmark::Metadata metadata;
+    metadata.threads = simulation.getThreadCount();
+    metadata.dt = simulation.getTimeStep();
+    metadata.softening = simulation.getSoftening();
+    metadata.solver = forceMethodName(simulation.getForceMethod());
+    metadata.integrator = integratorName(simulation.getIntegrator());
+    return metadata;
+}
+
+// Whether the benchmark's row still describes the simulation
+bool measuresCurrentRun(const Benchmark& benchmark, const Simulation& simulation) {
+    const Benchmark::Metadata& recorded = benchmark.getMetadata();
+    const Benchmark::Metadata current = metadataOf(simulation);
+    return benchmark.getImplementation() == simulation.getBackend().label() &&
+           benchmark.getNumBodies() == static_cast<int>(simulation.getStore().size()) &&
+           recorded.threads == current.threads && recorded.dt == current.dt &&
+           recorded.softening == current.softening && recorded.solver == current.solver &&
+           recorded.integrator == current.integrator;
 }
 
 void printUsage(const char* programName) {
-    std::cout << "Usage: " << programName << " [numBodies] [dt] [softening]\n";
+    std::cout << "Usage: " << programName << " [options] [numBodies] [dt] [softening]\n";
     std::cout << "  numBodies: Number of bodies in simulation (default: 1000, min: 2)\n";
     std::cout << "  dt:        Time step for simulation (default: 0.001, min: 0.0001)\n";
     std::cout << "  softening: Softening parameter (default: 2.0, min: 0.1)\n";
-    std::cout << "Example: " << programName << " 500 0.005 1.5\n";
+    std::cout << "Options:\n";
+    std::cout << "  --ic=disk|plummer|uniform|galaxies  Initial bodies (default: disk)\n";
+    std::cout << "  --seed=N                    Seed of the initial bodies, R moves to the next (default: 1)\n";
+    std::cout << "  --backend=serial|openmp|pool  Threads the forces run on (default: openmp, P cycles)\n";
+    std::cout << "  --solver=direct|barnes-hut|pm  Force solver (default: direct, B cycles)\n";
+    std::cout << "  --theta=VALUE               Barnes-Hut opening angle (default: 0.5)\n";
+    std::cout << "  --grid=CELLS                Particle-mesh cells per side (default: 256)\n";
+    std::cout << "  --assign=cic|tsc            Particle-mesh mass assignment (default: cic)\n";
+    std::cout << "  --p3m                       Add the short-range direct correction to the mesh\n";
+    std::cout << "  --pairs=symmetric|full      Parallel direct sum: each pair once with a\n";
+    std::cout << "                              per-thread reduction, or full rows without one\n";
+    std::cout << "  --tile=TARGETS,SOURCES      Direct-sum cache block sizes (default: from cache sizes)\n";
+    std::cout << "  --integrator=euler|leapfrog|verlet|yoshida4|block  Time integrator (default: euler, I cycles)\n";
+    std::cout << "  --reorder=none|morton|hilbert  Sort bodies along a space-filling curve (default: hilbert)\n";
+    std::cout << "  --reorder-interval=N        Steps between sorts, 0 to disable (default: 32)\n";
+    std::cout << "  --affinity=none|compact|spread  Pin threads to cores, spread over NUMA nodes (default: none)\n";
+    std::cout << "  --checkpoint=FILE           File F5 saves to and F9 loads from (default: checkpoint.nbody)\n";
+    std::cout << "  --restore=FILE              Start from a checkpoint; its bodies and parameters replace\n";
+    std::cout << "                              the ones given here\n";
+    std::cout << "  --trajectory=FILE           Stream positions and velocities to FILE for analysis\n";
+    std::cout << "  --trajectory-interval=K     Steps between trajectory frames (default: 10)\n";
+    std::cout << "  --trajectory-encoding=raw|quantized|delta  Frame encoding (default: delta)\n";
+    std::cout << "  --trajectory-precision=Q    Delta encoding: fixed-point step (default: 0.001)\n";
+    std::cout << "  --results=FILE              Benchmark results, .json for JSON lines (default: benchmark_results.csv)\n";
+    std::cout << "  --profile=FILE              Record phase timings, write a Chrome trace on exit\n";
+    std::cout << "  --physics-rate=STEPS        Cap simulation steps per second (default: unlimited)\n";
+    std::cout << "  --levels=N                  Block time steps: deepest level, dt / 2^N (default: 6)\n";
+    std::cout << "  --eta=VALUE                 Block time steps: accuracy parameter (default: 0.05)\n";
+    std::cout << "Example: " << programName << " --solver=barnes-hut 500 0.005 1.5\n";
 }
 
 int main(int argc, char* argv[]) {
-    // Automatically detect implementation from binary name
-    std::string implementation = detectImplementation(argv[0]);
-    
+    // The per-backend names of older builds still pick their backend
+    std::string backend = forceSolverForProgram(argv[0]);
+
     // Parse command line arguments
     int numBodies = 1000;
     float softening = 2.0f;
     float dt = 0.001f;
-    
-    if (argc > 1) {
-        // Show help if requested
-        if (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help") {
+    ForceMethod forceMethod = ForceMethod::Direct;
+    float theta = 0.5f;
+    ParticleMesh::Settings meshSettings;
+    DirectSumMode directMode = DirectSumMode::Symmetric;
+    KernelTiles kernelTiles{0, 0};
+    Integrator integrator = Integrator::Euler;
+    BlockStepSettings blockSteps;
+    ReorderSettings reorder;
+    AffinityMode affinity = AffinityMode::None;
+    float physicsRate = 0.0f;
+    std::string profilePath;
+    std::string resultsPath = "benchmark_results.csv";
+    std::string checkpointPath = "checkpoint.nbody";
+    std::string restorePath;
+    std::string trajectoryPath;
+    InitialConditions initialConditions;
+    TrajectorySettings trajectorySettings;
+
+    // Split "--option=value" flags from the positional arguments
+    std::vector<std::string> args;
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "-h" || arg == "--help") {
             printUsage(argv[0]);
             return 0;
         }
-        
+        if (arg.rfind("--", 0) != 0) {
+            args.push_back(arg);
+            continue;
+        }
+
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+        std::string value = (eq == std::string::npos) ? "" : arg.substr(eq + 1);
+
+        if (key == "backend") {
+            if (resolveForceSolverName(value).empty()) {
+                std::cout << "Unknown backend '" << value << "'. Using " << backend << "." << std::endl;
+            } else {
+                backend = value;
+            }
+        } else if (key == "solver") {
+            if (value == "barnes-hut" || value == "bh") {
+                forceMethod = ForceMethod::BarnesHut;
+            } else if (value == "pm" || value == "particle-mesh") {
+                forceMethod = ForceMethod::ParticleMesh;
+            } else if (value == "direct") {
+                forceMethod = ForceMethod::Direct;
+            } else {
+                std::cout << "Unknown solver '" << value << "'. Using direct sum." << std::endl;
+            }
+        } else if (key == "theta") {
+            try {
+                theta = std::stof(value);
+                if (theta <= 0.0f || theta > 2.0f) {
+                    std::cout << "Theta out of range (0, 2]. Using default: 0.5" << std::endl;
+                    theta = 0.5f;
+                }
+            } catch (const std::exception& e) {
+                std::cout << "Invalid theta. Using default: 0.5" << std::endl;
+                theta = 0.5f;
+            }
+        } else if (key == "grid") {
+            try {
+                meshSettings.gridSize = std::stoi(value);
+                if (meshSettings.gridSize < 16 || meshSettings.gridSize > 8192) {
+                    std::cout << "Grid size out of range [16, 8192]. Using default: 256" << std::endl;
+                    meshSettings.gridSize = 256;
+                }
+            } catch (const std::exception& e) {
+                std::cout << "Invalid grid size. Using default: 256" << std::endl;
+                meshSettings.gridSize = 256;
+            }
+        } else if (key == "assign") {
+            if (value == "tsc") {
+                meshSettings.assignment = MassAssignment::TSC;
+            } else if (value == "cic") {
+                meshSettings.assignment = MassAssignment::CIC;
+            } else {
+                std::cout << "Unknown mass assignment '" << value << "'. Using CIC." << std::endl;
+            }
+        } else if (key == "p3m") {
+            meshSettings.shortRange = true;
+        } else if (key == "pairs") {
+            if (value == "full") {
+                directMode = DirectSumMode::FullRow;
+            } else if (value == "symmetric") {
+                directMode = DirectSumMode::Symmetric;
+            } else {
+                std::cout << "Unknown pair mode '" << value << "'. Using symmetric." << std::endl;
+            }
+        } else if (key == "tile") {
+            try {
+                size_t comma = value.find(',');
+                kernelTiles.targetBlock = std::stoul(value.substr(0, comma));
+                kernelTiles.sourceBlock = (comma == std::string::npos) ? 0 : std::stoul(value.substr(comma + 1));
+            } catch (const std::exception& e) {
+                std::cout << "Invalid tile sizes. Using automatic tiling." << std::endl;
+                kernelTiles = KernelTiles{0, 0};
+            }
+        } else if (key == "integrator") {
+            if (!parseIntegrator(value, integrator)) {
+                std::cout << "Unknown integrator '" << value << "'. Using Euler." << std::endl;
+                integrator = Integrator::Euler;
+            }
+        } else if (key == "reorder") {
+            if (!parseCurve(value, reorder.curve)) {
+                std::cout << "Unknown curve '" << value << "'. Using hilbert." << std::endl;
+                reorder.curve = SpaceFillingCurve::Hilbert;
+            }
+        } else if (key == "reorder-interval") {
+            try {
+                reorder.interval = std::max(0, std::stoi(value));
+            } catch (const std::exception& e) {
+                std::cout << "Invalid reorder interval. Using default: 32" << std::endl;
+                reorder.interval = 32;
+            }
+        } else if (key == "affinity") {
+            if (!parseAffinity(value, affinity)) {
+                std::cout << "Unknown affinity '" << value << "'. Using none." << std::endl;
+                affinity = AffinityMode::None;
+            }
+        } else if (key == "checkpoint") {
+            if (!value.empty()) checkpointPath = value;
+        } else if (key == "restore") {
+            restorePath = value.empty() ? checkpointPath : value;
+        } else if (key == "ic") {
+            if (!parseDistribution(value, initialConditions.distribution)) {
+                std::cout << "Unknown initial conditions '" << value << "'. Using disk." << std::endl;
+                initialConditions.distribution = Distribution::Disk;
+            }
+        } else if (key == "seed") {
+            try {
+                initialConditions.seed = std::stoull(value);
+            } catch (const std::exception& e) {
+                std::cout << "Invalid seed. Using default: 1" << std::endl;
+                initialConditions.seed = 1;
+            }
+        } else if (key == "trajectory") {
+            trajectoryPath = value.empty() ? "trajectory.nbt" : value;
+        } else if (key == "trajectory-interval") {
+            try {
+                trajectorySettings.interval = std::stoi(value);
+                if (trajectorySettings.interval < 1) {
+                    std::cout << "Trajectory interval must be at least 1. Using default: 10" << std::endl;
+                    trajectorySettings.interval = 10;
+                }
+            } catch (const std::exception& e) {
+                std::cout << "Invalid trajectory interval. Using default: 10" << std::endl;
+                trajectorySettings.interval = 10;
+            }
+        } else if (key == "trajectory-encoding") {
+            if (!parseTrajectoryEncoding(value, trajectorySettings.encoding)) {
+                std::cout << "Unknown trajectory encoding '" << value << "'. Using delta." << std::endl;
+                trajectorySettings.encoding = TrajectoryEncoding::Delta;
+            }
+        } else if (key == "trajectory-precision") {
+            try {
+                trajectorySettings.precision = std::stof(value);
+                if (trajectorySettings.precision <= 0.0f) {
+                    std::cout << "Trajectory precision must be positive. Using default: 0.001" << std::endl;
+                    trajectorySettings.precision = 1e-3f;
+                }
+            } catch (const std::exception& e) {
+                std::cout << "Invalid trajectory precision. Using default: 0.001" << std::endl;
+                trajectorySettings.precision = 1e-3f;
+            }
+        } else if (key == "results") {
+            if (!value.empty()) resultsPath = value;
+        } else if (key == "profile") {
+            profilePath = value.empty() ? "trace.json" : value;
+        } else if (key == "physics-rate") {
+            try {
+                physicsRate = std::stof(value);
+                if (physicsRate < 0.0f) {
+                    std::cout << "Physics rate must not be negative. Using unlimited." << std::endl;
+                    physicsRate = 0.0f;
+                }
+            } catch (const std::exception& e) {
+                std::cout << "Invalid physics rate. Using unlimited." << std::endl;
+                physicsRate = 0.0f;
+            }
+        } else if (key == "levels") {
+            try {
+                blockSteps.maxLevel = std::stoi(value);
+                if (blockSteps.maxLevel < 0 || blockSteps.maxLevel > 20) {
+                    std::cout << "Levels out of range [0, 20]. Using default: 6" << std::endl;
+                    blockSteps.maxLevel = 6;
+                }
+            } catch (const std::exception& e) {
+                std::cout << "Invalid levels. Using default: 6" << std::endl;
+                blockSteps.maxLevel = 6;
+            }
+        } else if (key == "eta") {
+            try {
+                blockSteps.accuracy = std::stof(value);
+                if (blockSteps.accuracy <= 0.0f) {
+                    std::cout << "Eta must be positive. Using default: 0.05" << std::endl;
+                    blockSteps.accuracy = 0.05f;
+                }
+            } catch (const std::exception& e) {
+                std::cout << "Invalid eta. Using default: 0.05" << std::endl;
+                blockSteps.accuracy = 0.05f;
+            }
+        } else {
+            std::cout << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (args.size() > 0) {
         // Parse numBodies
         try {
-            numBodies = std::stoi(argv[1]);
+            numBodies = std::stoi(args[0]);
             if (numBodies <= 1) {
                 std::cout << "Number of bodies must be at least 2. Using default: 1000" << std::endl;
                 numBodies = 1000;
@@ -75,10 +311,10 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    if (argc > 2) {
+    if (args.size() > 1) {
         // Parse dt
         try {
-            dt = std::stof(argv[2]);
+            dt = std::stof(args[1]);
             if (dt < 0.0001f) {
                 std::cout << "Time step too small (min: 0.0001). Using default: 0.001" << std::endl;
                 dt = 0.001f;
@@ -92,10 +328,10 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    if (argc > 3) {
+    if (args.size() > 2) {
         // Parse softening
         try {
-            softening = std::stof(argv[3]);
+            softening = std::stof(args[2]);
             if (softening < 0.1f) {
                 std::cout << "Softening too small (min: 0.1). Using default: 2.0" << std::endl;
                 softening = 2.0f;
@@ -118,15 +354,44 @@ int main(int argc, char* argv[]) {
     bool showTrails = false;
     float zoomLevel = 1.0f;
     
+    // Initialize simulation
+    Simulation simulation(G, softening, dt, WINDOW_WIDTH, WINDOW_HEIGHT);
+    simulation.setBackend(backend);
+    const std::string implementation = simulation.getBackend().label();
+
     // Create window and view
     sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), 
                            "N-Body Simulation - " + implementation);
     window.setFramerateLimit(0);
     sf::View view = window.getDefaultView();
     
-    // Initialize simulation
-    Simulation simulation(G, softening, dt, WINDOW_WIDTH, WINDOW_HEIGHT);
-    simulation.initializeRandomBodies(numBodies, 100.0f, 8000.0f);
+    simulation.setForceMethod(forceMethod);
+    simulation.setTheta(theta);
+    simulation.setMeshSettings(meshSettings);
+    simulation.setDirectSumMode(directMode);
+    simulation.setKernelTiles(kernelTiles);
+    simulation.setIntegrator(integrator);
+    simulation.setBlockStepSettings(blockSteps);
+    simulation.setReorderSettings(reorder);
+    simulation.setAffinity(affinity);
+
+    std::string restoreError;
+    if (!restorePath.empty() && simulation.loadCheckpoint(restorePath, restoreError)) {
+        numBodies = static_cast<int>(simulation.getStore().size());
+        dt = simulation.getTimeStep();
+        softening = simulation.getSoftening();
+        forceMethod = simulation.getForceMethod();
+        integrator = simulation.getIntegrator();
+        std::cout << "Restored " << numBodies << " bodies at step " << simulation.getStepCount()
+                  << " from " << restorePath << std::endl;
+    } else {
+        if (!restorePath.empty()) {
+            std::cout << "Could not restore: " << restoreError << ". Starting with random bodies." << std::endl;
+        }
+        simulation.initializeBodies(numBodies, initialConditions);
+        std::cout << "Initial conditions: " << distributionName(initialConditions.distribution) << ", seed "
+                  << initialConditions.seed << std::endl;
+    }
     
     // Initialize managers
     UIManager uiManager(WINDOW_WIDTH, WINDOW_HEIGHT);
@@ -135,29 +400,96 @@ int main(int argc, char* argv[]) {
     TrailManager trailManager(WINDOW_WIDTH, WINDOW_HEIGHT);
     
     InputHandler inputHandler(showTrails, numBodies, dt, softening, G, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    // Outlives the runner, whose posted saves refer to it
+    CheckpointWriter checkpointWriter;
+    inputHandler.setCheckpoint(checkpointWriter, checkpointPath);
+
+    // Also outlives the runner, which records into it after every step
+    TrajectoryWriter trajectoryWriter;
+    if (!trajectoryPath.empty()) {
+        std::string error;
+        if (trajectoryWriter.open(trajectoryPath, trajectorySettings, error)) {
+            simulation.setTrajectoryWriter(&trajectoryWriter);
+            std::cout << "Trajectory: every " << trajectorySettings.interval << " steps to " << trajectoryPath
+                      << " (" << trajectoryEncodingName(trajectorySettings.encoding) << ")" << std::endl;
+        } else {
+            std::cout << "No trajectory: " << error << "." << std::endl;
+        }
+    }
     
-    // Initialize simple benchmark
-    Benchmark benchmark(implementation, numBodies);
-    globalBenchmark = &benchmark;  // Set global pointer for signal handler
+    // Benchmark the physics: every simulation step is one frame
+    Benchmark benchmark(implementation, static_cast<int>(simulation.getStore().size()));
+    benchmark.setMetadata(metadataOf(simulation));
     
     // Set up signal handler for graceful shutdown
     signal(SIGTERM, signalHandler);
     signal(SIGINT, signalHandler);
     
-    std::cout << "Detected implementation: " << implementation << " (from binary: " << argv[0] << ")" << std::endl;
+    std::cout << "Backend: " << simulation.getBackend().name() << " (" << simulation.getThreadCount()
+              << " thread(s)), P switches it while running" << std::endl;
     std::cout << "Running simulation with " << numBodies << " bodies" << std::endl;
+    KernelTiles tiles = simulation.getKernelTiles();
+    std::cout << "Direct-sum kernel: " << forceKernelName() << ", blocks of "
+              << tiles.targetBlock << " targets x " << tiles.sourceBlock << " sources" << std::endl;
+    printForceSolver(simulation);
+    std::cout << "Integrator: " << integratorName(simulation.getIntegrator()) << std::endl;
     std::cout << "Close the window or press Ctrl+C to save benchmark results." << std::endl;
     
+    if (!profilePath.empty()) {
+        Profiler::enable(true);
+        Profiler::setThreadName("render");
+    }
+
+    // Physics runs on its own thread from here on; the render loop only reads
+    // snapshots and posts commands
+    SimulationRunner runner(simulation, physicsRate);
+    // Runs on the simulation thread, after the posted commands. When a key
+    // has changed the backend, solver, integrator, dt, softening or body
+    // count, the row measured so far is saved and a new one starts with a
+    // fresh warm-up, so every row describes the run it timed.
+    runner.setStepObserver([&](double seconds) {
+        if (!measuresCurrentRun(benchmark, simulation)) {
+            if (benchmark.getMeasuredFrames() > 0) {
+                benchmark.saveResults(resultsPath);
+                std::cout << "Configuration changed, results so far saved to " << resultsPath << std::endl;
+            }
+            benchmark = Benchmark(simulation.getBackend().label(), static_cast<int>(simulation.getStore().size()));
+            benchmark.setMetadata(metadataOf(simulation));
+        }
+        benchmark.addFrameTime(seconds);
+    });
+    runner.start();
+    BodyRenderer bodyRenderer;
+    bodyRenderer.update(runner.latest());
+
+    // Stop stepping before the benchmark and the trace are read
+    auto shutdown = [&]() {
+        runner.stop();
+        trajectoryWriter.close();
+        benchmark.printSummary(std::cout);
+        benchmark.saveResults(resultsPath);
+        if (!profilePath.empty()) {
+            Profiler::printSummary(std::cout);
+            Profiler::writeChromeTrace(profilePath);
+        }
+    };
+
     // Main loop
     while (window.isOpen() && !shouldExit) {
+        PROFILE_SCOPE("frame");
+
         // Handle events
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (inputHandler.handleEvent(event, window, simulation, trailManager, 
-                                       uiManager, view, zoomLevel)) {
-                // Window is closing, save benchmark before exit
-                benchmark.saveResults();
-                return 0;
+        {
+            PROFILE_SCOPE("events");
+            sf::Event event;
+            while (window.pollEvent(event)) {
+                if (inputHandler.handleEvent(event, window, runner, trailManager, 
+                                           uiManager, view, zoomLevel)) {
+                    // Window is closing, save benchmark before exit
+                    shutdown();
+                    return 0;
+                }
             }
         }
         
@@ -167,41 +499,45 @@ int main(int argc, char* argv[]) {
             break;
         }
         
-        // Update simulation and managers
-        simulation.update();
+        // Pick up the latest completed step, if any, and update managers
+        const bool fresh = runner.acquire();
+        const BodySnapshot& bodies = runner.latest();
         uiManager.updateFPS();
-        trailManager.update(simulation.getBodies());
-        
-        // Record FPS for benchmark
-        benchmark.addFrame(uiManager.getFPS());
+        if (fresh) {
+            {
+                PROFILE_SCOPE("vertices");
+                bodyRenderer.update(bodies);
+            }
+            trailManager.update(bodyRenderer);
+        }
         
         // Update UI texts
-        uiManager.updateTexts(numBodies, dt, softening, trailManager.isEnabled(), uiManager.getFPS());
+        uiManager.updateTexts(static_cast<int>(bodies.size()), dt, softening, trailManager.isEnabled(),
+                              uiManager.getFPS(), runner.getStepsPerSecond());
         
         // Render
-        window.setView(view);
-        
-        if (trailManager.isEnabled()) {
-            trailManager.draw(window);
-        } else {
-            window.clear(sf::Color::Black);
-            // Draw bodies directly
-            const auto& bodies = simulation.getBodies();
-            for (const auto& body : bodies) {
-                sf::CircleShape circle(body.getRadius());
-                circle.setFillColor(body.getColor());
-                circle.setOrigin(body.getRadius(), body.getRadius());
-                circle.setPosition(body.getPosition());
-                window.draw(circle);
+        {
+            PROFILE_SCOPE("draw");
+            window.setView(view);
+            
+            if (trailManager.isEnabled()) {
+                trailManager.draw(window);
+            } else {
+                window.clear(sf::Color::Black);
+                bodyRenderer.draw(window);
             }
-        }
 
-        window.setView(window.getDefaultView());
-        
-        // Draw UI
-        uiManager.draw(window);
-        window.display();
+            window.setView(window.getDefaultView());
+            
+            // Draw UI
+            uiManager.draw(window);
+        }
+        {
+            PROFILE_SCOPE("display");
+            window.display();
+        }
     }
     
+    shutdown();
     return 0;
 }